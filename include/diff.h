@@ -35,6 +35,25 @@ enum fnc_diff_flag {
 #define FNC_DIFF_WIDTH_MASK	((uint64_t)0x00ff0000)    /* SBS column width */
 };
 
+/* Flags that change how blobs are broken into lines and diffed. */
+#define FNC_DIFF_LINE_FLAGS						\
+	(FNC_DIFF_IGNORE_ALLWS | FNC_DIFF_NOOPT | FNC_DIFF_NOTTOOBIG |	\
+	FNC_DIFF_STRIP_EOLCR)
+
+/*
+ * The lines of two blobs and the copy/delete/insert triples that turn one
+ * into the other, from which diffs of any context, width, or direction can be
+ * rendered without diffing the blobs again.
+ */
+struct fnc_diff {
+	fsl__diff_cx	c;
+	int		flags;	/* FNC_DIFF_LINE_FLAGS c was made with */
+	int		rc;	/* Error making c, if any */
+	bool		made;
+};
+static const struct fnc_diff fnc_diff_empty =
+    { fsl__diff_cx_empty_m, 0, 0, false };
+
 struct diff_out_state {
 	fsl_output_f	 out;		/* Output callback */
 	void		*state;		/* State for this->out() */
@@ -73,6 +92,12 @@ int		 fnc_diff_text(fsl_buffer const *, fsl_buffer const *,
 		    fsl_output_f, void *, short, short, int );
 int		 fnc_diff_blobs(fsl_buffer const *, fsl_buffer const *,
 		    fsl_output_f, void *, uint16_t, short, int, int **);
+int		 fnc_diff_prepare(struct fnc_diff *, fsl_buffer const *,
+		    fsl_buffer const *, int);
+int		 fnc_diff_render(const struct fnc_diff *, fsl_buffer const *,
+		    fsl_buffer const *, fsl_output_f, void *, uint16_t, short,
+		    int);
+void		 fnc_diff_free(struct fnc_diff *);
 int		 fnc_output_f_diff_out(void *, void const *, fsl_size_t);
 int		 diff_outf(struct diff_out_state *, char const *, ... );
 int		 diff_out(struct diff_out_state * const, void const *,
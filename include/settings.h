@@ -48,6 +48,9 @@
 	_(pfx, VIEW_SPLIT_MODE),				\
 	_(pfx, VIEW_SPLIT_WIDTH),				\
 	_(pfx, VIEW_SPLIT_HEIGHT),				\
+	_(pfx, PREFETCH_PAGES),					\
+	_(pfx, TIMELINE_WINDOW),				\
+	_(pfx, DIFF_CACHE),					\
 	_(pfx, EOF_SETTINGS)
 
 #define LINE_ATTR_ENUM(pfx, _)					\
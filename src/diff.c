@@ -128,56 +128,87 @@ fnc_diff_blobs(fsl_buffer const *blob1, fsl_buffer const *blob2,
     fsl_output_f out, void *state, /* void *regex, */ uint16_t context,
     short sbswidth, int flags, int **rawdata)
 {
-	fsl__diff_cx	c = fsl__diff_cx_empty;
+	struct fnc_diff	d = fnc_diff_empty;
 	int		rc;
 
 	if (!blob1 || !blob2 || (out && rawdata) || (!out && !rawdata))
 		return FSL_RC_MISUSE;
 
-	if (context < 0)
-		context = 5;
-	else if (context & ~FSL__LINE_LENGTH_MASK)
-		context = FSL__LINE_LENGTH_MASK;
+	if (rawdata) {
+		if (flags & FNC_DIFF_INVERT) {
+			fsl_buffer const *tmp = blob1;
+			blob1 = blob2;
+			blob2 = tmp;
+		}
+		rc = fnc_diff_prepare(&d, blob1, blob2, flags);
+		if (!rc) {
+			/* Return array of COPY/DELETE/INSERT triples. */
+			*rawdata = d.c.aEdit;
+			d.c.aEdit = NULL;
+		}
+	} else {
+		rc = fnc_diff_prepare(&d, blob1, blob2, flags);
+		if (!rc)
+			rc = fnc_diff_render(&d, blob1, blob2, out, state,
+			    context, sbswidth, flags);
+	}
 
-	/* Encode SBS width. */
-	if (sbswidth < 0 || (!sbswidth && (FNC_DIFF_SIDEBYSIDE & flags)))
-		sbswidth = 80;
-	if (sbswidth)
-		flags |= FNC_DIFF_SIDEBYSIDE;
-	flags |= ((int)(sbswidth & 0xFF)) << 16;
+	fnc_diff_free(&d);
+	return rc;
+}
 
-	if (flags & FNC_DIFF_INVERT) {
-		fsl_buffer const *tmp = blob1;
-		blob1 = blob2;
-		blob2 = tmp;
-	}
+/*
+ * Break blob1 and blob2 into lines and compute the copy/delete/insert
+ * triples that turn the former into the latter, from which fnc_diff_render()
+ * can make any number of diffs. Only the FNC_DIFF_LINE_FLAGS in flags change
+ * the result, so if d was already prepared with the same ones, it's left as
+ * is, and the error it was prepared with, if any, is returned. The blobs must
+ * outlive d, as its lines point into them. Return 0 on success, any number of
+ * other codes on error.
+ */
+int
+fnc_diff_prepare(struct fnc_diff *d, fsl_buffer const *blob1,
+    fsl_buffer const *blob2, int flags)
+{
+	fsl__diff_cx	*c = &d->c;
+	int		 dlflags, rc;
+
+	flags &= FNC_DIFF_LINE_FLAGS;
+	if (d->made && d->flags == flags)
+		return d->rc;
+	fnc_diff_free(d);
+
+	/* Only the whitespace flags are shared with libfossil. */
+	dlflags = flags & FNC_DIFF_IGNORE_ALLWS;
+	if (flags & FNC_DIFF_STRIP_EOLCR)
+		dlflags |= FSL_DIFF2_STRIP_EOLCR;
 
 	if ((flags & FNC_DIFF_IGNORE_ALLWS) == FNC_DIFF_IGNORE_ALLWS)
-		c.cmpLine = fsl_dline_cmp_ignore_ws;
+		c->cmpLine = fsl_dline_cmp_ignore_ws;
 	else
-		c.cmpLine = fsl_dline_cmp;
+		c->cmpLine = fsl_dline_cmp;
 
 	/* Prepare input files. */
 	rc = fsl_break_into_dlines(fsl_buffer_cstr(blob1),
-	    (fsl_int_t)fsl_buffer_size(blob1), (uint32_t*)&c.nFrom, &c.aFrom,
-	    flags);
+	    (fsl_int_t)fsl_buffer_size(blob1), (uint32_t*)&c->nFrom,
+	    &c->aFrom, dlflags);
 	if (rc)
 		goto end;
 	rc = fsl_break_into_dlines(fsl_buffer_cstr(blob2),
-	    (fsl_int_t)fsl_buffer_size(blob2), (uint32_t*)&c.nTo, &c.aTo,
-	    flags);
+	    (fsl_int_t)fsl_buffer_size(blob2), (uint32_t*)&c->nTo,
+	    &c->aTo, dlflags);
 	if (rc)
 		goto end;
 
 	/* Compute the difference */
-	rc = fsl__diff_all(&c);
-	/* fsl__dump_triples(&c, __FILE__, __LINE__); */  /* DEBUG */
+	rc = fsl__diff_all(c);
+	/* fsl__dump_triples(c, __FILE__, __LINE__); */  /* DEBUG */
 	if (rc)
 		goto end;
 	if ((flags & FNC_DIFF_NOTTOOBIG)) {
 		int i, m, n;
-		int *a = c.aEdit;
-		int mx = c.nEdit;
+		int *a = c->aEdit;
+		int mx = c->nEdit;
 
 		for (i = m = n = 0; i < mx; i += 3) {
 			m += a[i];
@@ -189,40 +220,104 @@ fnc_diff_blobs(fsl_buffer const *blob1, fsl_buffer const *blob2,
 			goto end;
 		}
 	}
-	/* fsl__dump_triples(&c, __FILE__, __LINE__); */  /* DEBUG */
+	/* fsl__dump_triples(c, __FILE__, __LINE__); */  /* DEBUG */
 	if (!(flags & FNC_DIFF_NOOPT))
-		fsl__diff_optimize(&c);
-	/* fsl__dump_triples(&c, __FILE__, __LINE__); */  /* DEBUG */
+		fsl__diff_optimize(c);
+	/* fsl__dump_triples(c, __FILE__, __LINE__); */  /* DEBUG */
+end:
+	if (rc)
+		fnc_diff_free(d);
+	d->made = true;
+	d->flags = flags;
+	d->rc = rc;
+	return rc;
+}
 
-	if (out) {
-		/*
-		 * XXX Missing regex support.
-		 * Compute a context or side-by-side diff.
-		 */
-		struct diff_out_state dos = diff_out_state_empty;
-		if (flags & FNC_DIFF_PROTOTYPE) {
-			memset(&dos.proto, 0, sizeof(dos.proto));
-			dos.proto.file = blob1;
+/*
+ * Stream the diff prepared in d from blob1 and blob2 to out, with context
+ * lines of context (negative values fallback to default) in sbswidth columns
+ * (0 = unidiff; negative values fallback to default). If flags has
+ * FNC_DIFF_INVERT, the diff is rendered from blob2 to blob1 by swapping the
+ * sides of d rather than diffing the blobs again. Return 0 on success, any
+ * number of other codes on error.
+ */
+int
+fnc_diff_render(const struct fnc_diff *d, fsl_buffer const *blob1,
+    fsl_buffer const *blob2, fsl_output_f out, void *state,
+    uint16_t context, short sbswidth, int flags)
+{
+	struct diff_out_state	dos = diff_out_state_empty;
+	fsl__diff_cx		c = d->c;
+	int			i, rc;
+
+	if (!d->made || d->rc || !out)
+		return FSL_RC_MISUSE;
+
+	if (context < 0)
+		context = 5;
+	else if (context & ~FSL__LINE_LENGTH_MASK)
+		context = FSL__LINE_LENGTH_MASK;
+
+	/* Encode SBS width. */
+	if (sbswidth < 0 || (!sbswidth && (FNC_DIFF_SIDEBYSIDE & flags)))
+		sbswidth = 80;
+	if (sbswidth)
+		flags |= FNC_DIFF_SIDEBYSIDE;
+	flags |= ((int)(sbswidth & 0xFF)) << 16;
+
+	if (flags & FNC_DIFF_INVERT) {
+		fsl_buffer const *tmp = blob1;
+		blob1 = blob2;
+		blob2 = tmp;
+
+		/* Deletions from one side are insertions to the other. */
+		c.aFrom = d->c.aTo;
+		c.nFrom = d->c.nTo;
+		c.aTo = d->c.aFrom;
+		c.nTo = d->c.nFrom;
+		c.aEdit = fsl_malloc(c.nEdit * sizeof(*c.aEdit));
+		if (c.aEdit == NULL && c.nEdit)
+			return FSL_RC_OOM;
+		for (i = 0; i < c.nEdit; i += 3) {
+			c.aEdit[i] = d->c.aEdit[i];
+			c.aEdit[i + 1] = d->c.aEdit[i + 2];
+			c.aEdit[i + 2] = d->c.aEdit[i + 1];
 		}
-		dos.out = out;
-		dos.state = state;
-		dos.ansi = !!(flags & FNC_DIFF_ANSI_COLOR);
-		if (flags & FNC_DIFF_SIDEBYSIDE)
-			rc = sbsdiff(&c, &dos, NULL /*regex*/, context, flags);
-		else
-			rc = unidiff(&c, &dos, NULL /*regex*/, context, flags);
-	} else if (rawdata) {
-		/* Return array of COPY/DELETE/INSERT triples. */
-		*rawdata = c.aEdit;
-		c.aEdit = NULL;
 	}
-end:
-	fsl_free(c.aFrom);
-	fsl_free(c.aTo);
-	fsl_free(c.aEdit);
+
+	/*
+	 * XXX Missing regex support.
+	 * Compute a context or side-by-side diff.
+	 */
+	if (flags & FNC_DIFF_PROTOTYPE) {
+		memset(&dos.proto, 0, sizeof(dos.proto));
+		dos.proto.file = blob1;
+	}
+	dos.out = out;
+	dos.state = state;
+	dos.ansi = !!(flags & FNC_DIFF_ANSI_COLOR);
+	if (flags & FNC_DIFF_SIDEBYSIDE)
+		rc = sbsdiff(&c, &dos, NULL /*regex*/, context, flags);
+	else
+		rc = unidiff(&c, &dos, NULL /*regex*/, context, flags);
+
+	if (c.aEdit != d->c.aEdit)
+		fsl_free(c.aEdit);
 	return rc;
 }
 
+/*
+ * Free the lines and triples of d, which may be prepared again.
+ */
+void
+fnc_diff_free(struct fnc_diff *d)
+{
+	fsl_free(d->c.aFrom);
+	fsl_free(d->c.aTo);
+	fsl_free(d->c.aEdit);
+	*d = fnc_diff_empty;
+}
+
 /*
  * Convert mask of public fnc_diff_flag (32-bit) values to the Fossil-internal
  * 64-bit bitmask used by the DIFF_xxx macros because fossil(1) uses the macro
@@ -567,7 +662,7 @@ sbsdiff(fsl__diff_cx *cx, struct diff_out_state *out, void *regex,
 			    fsl_buffer_empty_m
 			 };
 	struct sbsline	 s;		/* Output line buffer */
-	static int	 chunks = 0;	/* Number of chunks so far processed */
+	int		 chunks = 0;	/* Number of chunks so far processed */
 	int		 li, ri;	/* Index of next line in l[] and r[] */
 	int		*c;		/* copy/delete/insert triples */
 	int		 ci;		/* Index into c[] */
@@ -908,7 +1003,7 @@ unidiff(fsl__diff_cx *cx, struct diff_out_state *out, void *regex,
     uint16_t context, uint64_t flags)
 {
 	fsl_dline	*l, *r;		/* Left and right side of diff */
-	static int	 chunks = 0;	/* Number of chunks so far processed */
+	int		 chunks = 0;	/* Number of chunks so far processed */
 	int		 li, ri;	/* Index of next line in l[] and r[] */
 	int		*c;		/* copy/delete/insert triples */
 	int		 ci;		/* Index into c[] */
@@ -52,14 +52,17 @@
 #include <curses.h>
 #include <panel.h>
 #include <locale.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <err.h>
 #include <unistd.h>
 #include <limits.h>
 #include <errno.h>
+#include <float.h>
 #include <pthread.h>
 #include <libgen.h>
 #include <regex.h>
@@ -97,6 +100,18 @@
 #define DEF_DIFF_CTX	5		/* Default diff context lines. */
 #define MAX_DIFF_CTX	64		/* Max diff context lines. */
 #define HSPLIT_SCALE	0.4		/* Default horizontal split scale. */
+#define PREFETCH_PAGES	4		/* Default timeline read-ahead pages. */
+#define MAX_PREFETCH	1024		/* Max timeline read-ahead pages. */
+#define TL_BATCH_MAX	256		/* Max commits published per lock. */
+#define TL_FTS_BATCH	4096		/* Events indexed per idle step. */
+#define TL_SCAN_MIN	8192		/* Loaded commits to scan at once. */
+#define TL_SCAN_THREADS	8		/* Max search workers. */
+#define DIFF_POOL_MIN	64		/* Changed files to diff in parallel. */
+#define DIFF_THREADS	16		/* Max file diff workers. */
+#define DIFF_CACHE_MB	64		/* Default diff view cache size. */
+#define MAX_DIFF_CACHE	1048576		/* Max diff view cache size in MiB. */
+#define TL_PATH_SORT_MAX 32768		/* Max path changes to sort by mtime. */
+#define MAX_TL_WINDOW	100000000	/* Max timeline window size. */
 #define SPIN_INTERVAL	200		/* Status line progress indicator. */
 #define LINENO_WIDTH	6		/* View lineno max column width. */
 #define MAX_PCT_LEN	7		/* Line position upto max len 99.99% */
@@ -195,6 +210,7 @@ static struct fnc_setup {
 	const char	*filter_type;	/* Placeholder for repeatable types. */
 	const char	*glob;		/* Only load commits containing glob */
 	bool		 utc;		/* Display UTC sans user local time. */
+	bool		 ancestors;	/* Only load ancestors of the start. */
 
 	/* Blame options. */
 	const char	*lineno;	/* Line to open blame view. */
@@ -223,7 +239,7 @@ static struct fnc_setup {
 	fcli_help_info	  fnc_help;			/* Global help. */
 	fcli_cliflag	  cliflags_global[3];		/* Global options. */
 	fcli_command	  cmd_args[7];			/* App commands. */
-	fcli_cliflag	  cliflags_timeline[13];	/* Timeline options. */
+	fcli_cliflag	  cliflags_timeline[14];	/* Timeline options. */
 	fcli_cliflag	  cliflags_diff[9];		/* Diff options. */
 	fcli_cliflag	  cliflags_tree[5];		/* Tree options. */
 	fcli_cliflag	  cliflags_blame[8];		/* Blame options. */
@@ -245,6 +261,7 @@ static struct fnc_setup {
 	NULL,		/* filter_type temp placeholder for filter_types cb. */
 	NULL,		/* glob filter defaults to off; all commits are shown */
 	false,		/* utc defaults to off (i.e., show user local time). */
+	false,		/* ancestors defaults to off (i.e., all commits). */
 	NULL,		/* lineno default: open blame at the first line. */
 	NULL,		/* context defaults to five context lines. */
 	false,		/* ws defaults to acknowledge whitespace. */
@@ -297,6 +314,10 @@ static struct fnc_setup {
 	},
 
 	{ /* cliflags_timeline timeline command related options. */
+	    FCLI_FLAG_BOOL("a", "ancestors", &fnc_init.ancestors,
+	    "Only display ancestors of the commit the timeline is opened from\n"
+	    "    (see --commit), or of the current checkout or tip. With "
+	    "--limit,\n    only the <n> latest ancestors are found."),
 	    FCLI_FLAG("b", "branch", "<branch>", &fnc_init.filter_branch,
 	    "Only display commits that reside on the given <branch>."),
 	    FCLI_FLAG_BOOL("C", "no-colour", &fnc_init.nocolour,
@@ -513,8 +534,7 @@ enum fnc_search_state {
 	SEARCH_WAITING,
 	SEARCH_CONTINUE,
 	SEARCH_COMPLETE,
-	SEARCH_NO_MATCH,
-	SEARCH_FOR_END
+	SEARCH_NO_MATCH
 };
 
 enum fnc_diff_type {
@@ -540,20 +560,72 @@ struct fnc_colour {
 };
 STAILQ_HEAD(fnc_colours, fnc_colour);
 
+/*
+ * Bump allocator for objects that share a lifetime, such as the commits of a
+ * timeline: memory is carved from large blocks, and only released all at once
+ * by fnc_arena_free(). An arena must only be allocated from by one thread.
+ * Strings that recur across many objects (e.g., usernames and branches) can
+ * be interned into the arena's string table with fnc_arena_intern().
+ */
+#define ARENA_BLOCK_SZ	(64 * 1024)
+
+/*
+ * Interned string preceded by a header that caches the result of the last
+ * search it was tested against; see find_commit_match().
+ */
+struct fnc_istr {
+	uint32_t	 hash;
+	int		 search_gen;	/* Search that last tested str. */
+	bool		 match;		/* Whether str matched that search. */
+	char		 str[];
+};
+
+struct fnc_arena_block {
+	struct fnc_arena_block	*next;
+	size_t			 used;
+	size_t			 size;
+	double			 mem[];	/* Aligned for any field we store. */
+};
+
+struct fnc_arena {
+	struct fnc_arena_block	*head;	 /* Block currently allocated from. */
+	struct fnc_istr		**strtab; /* Open addressed interned strings. */
+	uint32_t		 nslots; /* Size of strtab; a power of 2. */
+	uint32_t		 nstrs;	 /* Strings interned in strtab. */
+	size_t			 nbytes; /* Total bytes in all blocks. */
+};
+
+/* Strings assigned to arena commits after they were built, see close(). */
+#define COMMIT_HEAP_BRANCH	0x01
+
+/*
+ * Commit hashes are kept as binary SHA1 or SHA3-256 digests, and only
+ * formatted as hex with fnc_hash_hex() when displayed or passed to libfossil.
+ */
+#define FNC_HASH_MAX	32			/* SHA3-256 digest length. */
+#define FNC_HASH_HEXSZ	(FNC_HASH_MAX * 2 + 1)	/* Hex digits + NUL. */
+
+struct fnc_hash {
+	unsigned char	d[FNC_HASH_MAX];
+	uint8_t		len;	/* Length of digest in d; 0 if none. */
+};
+
 struct fnc_commit_artifact {
+	struct fnc_arena	*arena;	/* Owner of storage, NULL if heap. */
 	fsl_buffer		 wiki;
 	fsl_buffer		 pwiki;
 	fsl_list		 changeset;
-	fsl_uuid_str		 uuid;
-	fsl_uuid_str		 puuid;
+	struct fnc_hash		 uuid;
+	struct fnc_hash		 puuid;
 	fsl_id_t		 rid;
 	fsl_id_t		 prid;
+	double			 mtime;
 	char			*user;
-	char			*timestamp;
 	char			*comment;
 	char			*branch;
-	char			*type;
+	const char		*type;	/* Static string. */
 	enum fnc_diff_type	 diff_type;
+	uint8_t			 heapstr;  /* COMMIT_HEAP_* */
 };
 
 struct fsl_file_artifact {
@@ -561,16 +633,60 @@ struct fsl_file_artifact {
 	enum fsl_ckout_change_e	 change;
 };
 
-TAILQ_HEAD(commit_tailhead, commit_entry);
+/*
+ * Timeline commits are stored by value in fixed-size chunks so that entries
+ * never move once appended, and any commit can be reached by its index in
+ * O(1) with commit_queue_get(). Each entry keeps the fixed-width keys of its
+ * commit so that cursor moves and index lookups don't chase the artifact.
+ *
+ * Each chunk owns the arena its commits are built in, so that in windowed
+ * mode (FNC_TIMELINE_WINDOW) a chunk far from the view can be released as a
+ * whole by tl_trim_commits(). The (mtime, rid) key of the first commit in
+ * every chunk is retained, and an evicted chunk is transparently reloaded
+ * with a keyset query from that key when commit_queue_get() next touches it.
+ *
+ * A jump far down the timeline skips over the chunks in between rather than
+ * load them; see tl_goto_commit(). Their keys are unknown (i.e., rid 0) until
+ * one is touched, when it is found by skipping from the nearest known key
+ * through the event index, and the chunk is reloaded like any other.
+ */
+#define COMMIT_CHUNK_SHIFT	9
+#define COMMIT_CHUNK_SZ		(1 << COMMIT_CHUNK_SHIFT)
+#define COMMIT_CHUNK_MASK	(COMMIT_CHUNK_SZ - 1)
+
 struct commit_entry {
-	TAILQ_ENTRY(commit_entry)	 entries;
 	struct fnc_commit_artifact	*commit;
+	double				 mtime;
+	fsl_id_t			 rid;
+	fsl_id_t			 prid;
 	int				 idx;
 };
 
+struct commit_chunk {
+	struct fnc_arena	arena;	/* Commit artifacts and strings. */
+	struct commit_entry	entries[COMMIT_CHUNK_SZ];
+};
+
+struct commit_key {
+	double		mtime;
+	fsl_id_t	rid;
+};
+
 struct commit_queue {
-	struct commit_tailhead	head;
-	int			ncommits;
+	struct commit_chunk	**chunks;   /* NULL if evicted or unused. */
+	struct commit_key	 *keys;     /* First commit of each chunk. */
+	fsl_stmt		 *refetch;  /* Reloads a chunk by key. */
+	fsl_stmt		 *skip;     /* Key n commits after a key. */
+	fsl_stmt		 *rskip;    /* Key n commits before a key. */
+	fsl_stmt		 *rank;     /* Commits before a key. */
+	char			 *resume;   /* SQL of refetch. */
+	char			 *keyset;   /* SQL of the others, sans order. */
+	fsl_id_t		  root;     /* Root of tmp_ancestor, or 0. */
+	int			  nchunks;  /* Allocated chunk pointers. */
+	int			  ncommits;
+	int			  window;   /* Commits kept either side of the
+					     * view; 0 keeps every commit. */
+	bool			  grown;    /* Chunk loaded since last trim. */
 };
 
 /*
@@ -637,7 +753,7 @@ struct fnc_tl_thread_cx {
 	struct commit_queue	 *commits;
 	struct commit_entry	**first_commit_onscreen;
 	struct commit_entry	**selected_commit;
-	fsl_db			 *db;
+	fsl_db			 *db;	     /* Private read-only connection. */
 	fsl_stmt		 *q;
 	regex_t			 *regex;
 	char			 *path;	     /* Match commits involving path. */
@@ -645,19 +761,74 @@ struct fnc_tl_thread_cx {
 	enum fnc_search_mvmnt	 *searching;
 	int			  spin_idx;
 	int			  ncommits_needed;
+	int			  nprefetch;   /* Commits to keep loaded
+					      * from the first onscreen
+					      * commit. */
+	int			  search_gen;  /* Bumped for each new search. */
+	char			 *search_re;   /* Pattern of search. */
+	char			 *fts_sql;     /* Candidates after a commit. */
+	char			 *fts_match;   /* tmp_fts MATCH of search. */
+	char			 *fts_glob;    /* Hash GLOB, if any. */
+	fsl_stmt		 *fts_q;
+	struct commit_key	  search_key;  /* Last commit searched. */
+	struct commit_key	  seek_key;    /* First commit in seek_idx's
+					      * chunk. */
+	int			  seek_idx;    /* Commit to resume the query at,
+					      * skipping those before, or -1. */
+	fsl_id_t		  search_rid;  /* Next match after
+					      * search_key per tmp_fts,
+					      * -1 if none, else 0. */
+	bool			  search_fts;  /* Look up search_rid. */
+	bool			  fts_done;    /* Every event is in tmp_fts. */
+	bool			  nofts;       /* tmp_fts can't be built. */
 	/*
 	 * XXX Is there a more elegant solution to retrieving return codes from
 	 * thread functions while pinging between, but before we join, threads?
 	 */
 	int			  rc;
-	bool			  endjmp;
 	bool			  eotl;
-	bool			  reset;
 	sig_atomic_t		 *quit;
 	pthread_cond_t		  commit_consumer;
 	pthread_cond_t		  commit_producer;
 };
 
+/*
+ * A search of loaded commits split across worker threads by tl_scan_commits().
+ * Each worker compiles its own copy of re, claims the next unclaimed chunk in
+ * the search direction, and tests it up to its first match. As chunks are
+ * claimed in order, none beyond the nearest match found so far need testing.
+ */
+struct tl_scan {
+	struct commit_queue	*commits;
+	const char		*re;
+	int			 search_gen;
+	int			 start;	   /* First commit to test. */
+	int			 end;	   /* Last commit to test. */
+	int			 dir;	   /* 1 if forward, else -1. */
+	int			 next;	   /* Next chunk to claim. */
+	int			 match;	   /* Nearest match so far, or -1. */
+	int			 nrunning;
+	volatile sig_atomic_t	 cancel;
+	pthread_mutex_t		 mutex;
+};
+
+/*
+ * Timeline dates are formatted from each commit's julian mtime only when its
+ * line is drawn. Adjacent lines mostly share a date, so the last few days
+ * formatted are cached along with the [start, end) time span each covers.
+ */
+#define FNC_DATE_CACHE_SZ	8
+
+struct fnc_date_cache {
+	struct {
+		time_t	start;
+		time_t	end;
+		char	date[ISO8601_DATE_ONLY + 2];  /* Date + space + NUL. */
+	} slot[FNC_DATE_CACHE_SZ];
+	int	nslots;
+	int	next;  /* Slot to replace on the next miss. */
+};
+
 struct fnc_tl_view_state {
 	struct fnc_tl_thread_cx	 thread_cx;
 	struct commit_queue	 commits;
@@ -667,14 +838,18 @@ struct fnc_tl_view_state {
 	struct commit_entry	*matched_commit;
 	struct commit_entry	*search_commit;
 	struct fnc_colours	 colours;
+	struct fnc_date_cache	 dates;
 	const char		*curr_ckout_uuid;
 	const char		*glob;  /* Match commits containing glob. */
 	char			*path;	/* Match commits involving path. */
 	int			 selected_idx;
 	int			 nscrolled;
+	int			 prefetch_pages;  /* FNC_PREFETCH_PAGES */
+	int			 diff_idx;  /* Commit in diff view, or -1. */
 	sig_atomic_t		 quit;
 	pthread_t		 thread_id;
 	bool			 colour;
+	bool			 polling;  /* Searching; see start_polling(). */
 };
 
 struct fnc_pathlist_entry {
@@ -687,19 +862,119 @@ TAILQ_HEAD(fnc_pathlist_head, fnc_pathlist_entry);
 
 struct index {
 	size_t		*lineno;
-	off_t		*offset;
 	uint32_t	 n;
 	uint32_t	 idx;
 };
 
+/*
+ * A file to be diffed by diff_tasks(), and its diff once done. Tasks are
+ * added to the view in the order of the F-cards they came from. They are kept
+ * with the content of both versions of the file and their prepared diff until
+ * another version is diffed, so that a new context, prototype, line number,
+ * or invert setting only renders the diff again. What they keep counts
+ * toward FNC_DIFF_CACHE.
+ */
+struct fnc_diff_task {
+	const fsl_card_F	*a;	/* File diffed against, if any. */
+	const fsl_card_F	*b;	/* File diffed, if any. */
+	fsl_buffer		 buf;
+	fsl_buffer		 blob1;	/* Content of a. */
+	fsl_buffer		 blob2;	/* Content of b. */
+	struct fnc_diff		 diff;
+	char			*zminus;	/* Blob names and hashes. */
+	char			*zplus;
+	fsl_uuid_str		 xminus;
+	fsl_uuid_str		 xplus;
+	fsl_ckout_change_e	 change;
+	bool			 fetched;	/* blob1 and blob2 are set. */
+	bool			 done;
+};
+
+/* What a commit or blob diff is made of, and made with. */
+struct fnc_diff_key {
+	struct fnc_hash	uuid;
+	struct fnc_hash	puuid;
+	int		diff_flags;
+	int		context;
+	int		sbs;
+	size_t		ncols;	/* Commit header wrapped to, or 0 if none. */
+};
+
+/*
+ * A finished commit or blob diff, kept by the diff view so that revisiting a
+ * version with the same options (e.g., with J/K) needn't diff it again. The
+ * view's cache holds those most recently shown, up to FNC_DIFF_CACHE MiB.
+ */
+struct fnc_diff_cached {
+	TAILQ_ENTRY(fnc_diff_cached)	 entry;
+	struct fnc_diff_key		 key;
+	fsl_buffer			 text;
+	off_t				*line_offsets;
+	size_t				*lineno;	/* File index. */
+	size_t				 nlines;
+	size_t				 size;	/* Bytes held. */
+	uint32_t			 nfiles;
+	int				 maxx;
+};
+TAILQ_HEAD(fnc_diff_cache, fnc_diff_cached);
+
+struct fnc_diff_worker {
+	struct fnc_diff_thread_cx	*cx;
+	fsl_cx				*f;	/* Read-only fcli_cx() clone. */
+	pthread_t			 id;
+};
+
+/*
+ * Commit and blob diffs are made on a thread of their own, which adds each
+ * file's diff to the view as soon as it's made. It works from a copy of the
+ * view state it needs, which may change (e.g., by J/K or a toggle) before the
+ * view restarts it with stop_diff() and start_diff(). The files of a large
+ * commit are shared with up to DIFF_THREADS - 1 workers, each with its own
+ * clone of fcli_cx(); the task list and the fields that follow it are only
+ * touched with fnc_mutex held.
+ */
+struct fnc_diff_thread_cx {
+	struct fnc_diff_view_state	*s;
+	struct fnc_pathlist_head	*paths;
+	fsl_cx				*f;	/* Read-only fcli_cx() clone. */
+	struct fnc_diff_worker		 pool[DIFF_THREADS - 1];
+	int				 npool;	/* Clones opened in pool. */
+	int				 nworkers; /* Workers to start. */
+	fsl_id_t			 rid;	/* Version or blob diffed. */
+	fsl_id_t			 prid;	/* Blob diffed against. */
+	fsl_id_t			 id1;	/* Version diffed against. */
+	char				 pid[FNC_HASH_HEXSZ]; /* Parent hash. */
+	fsl_deck			 d1;	/* Decks the tasks' */
+	fsl_deck			 d2;	/* F-cards are in. */
+	struct fnc_diff_key		 key;
+	enum fnc_diff_type		 type;
+	int				 diff_flags;
+	int				 context;
+	int				 sbs;
+	int				 rc;
+	struct fnc_diff_task		*tasks;
+	int				 ntasks;
+	int				 next;	/* Task to diff next. */
+	int				 npublished; /* Tasks in the view. */
+	size_t				 tasksz; /* Bytes the tasks keep. */
+	bool				 quit;
+	bool				 complete;
+	bool				 whole;	/* Finished uncut. */
+};
+
 struct fnc_diff_view_state {
 	struct fnc_view			*timeline_view;
 	struct fnc_commit_artifact	*selected_commit;
 	struct fnc_pathlist_head	*paths;
+	struct fnc_diff_thread_cx	 thread_cx;
+	pthread_t			 thread_id;
+	struct fnc_diff_cache		 cache;	/* Most recent first. */
+	size_t				 cachesz;
+	size_t				 cachemax;  /* FNC_DIFF_CACHE */
 	fsl_buffer			 buf;
 	struct fnc_colours		 colours;
 	struct index			 index;
-	FILE				*f;
+	fsl_buffer			 text;	/* NUL-terminated lines. */
 	fsl_uuid_str			 id1;
 	fsl_uuid_str			 id2;
 	int				 first_line_onscreen;
@@ -715,11 +990,13 @@ struct fnc_diff_view_state {
 	size_t				 ncols;
 	size_t				 nlines;
 	enum line_attr			 sline;
-	off_t				*line_offsets;
+	off_t				*line_offsets;	/* Of lines in text. */
+	size_t				 noffsets;	/* Allocated. */
 	bool				 eof;
 	bool				 colour;
 	bool				 showmeta;
 	bool				 showln;
+	bool				 polling;  /* See start_polling(). */
 };
 
 TAILQ_HEAD(fnc_parent_trees, fnc_parent_tree);
@@ -763,6 +1040,7 @@ typedef int (*fnc_cancel_cb)(void *);
 
 struct fnc_blame_thread_cx {
 	struct fnc_blame_cb_cx	*cb_cx;
+	fsl_cx			*f;	/* Read-only clone of fcli_cx(). */
 	fsl_annotate_opt	 blame_opt;
 	fnc_cancel_cb		 cancel_cb;
 	const char		*path;
@@ -810,6 +1088,7 @@ struct fnc_blame_view_state {
 	bool				 eof;
 	bool				 colour;
 	bool				 showln;
+	bool				 polling;  /* See start_polling(). */
 };
 
 struct fnc_branch {
@@ -911,6 +1190,7 @@ struct fnc_view {
 static volatile sig_atomic_t rec_sigwinch;
 static volatile sig_atomic_t rec_sigpipe;
 static volatile sig_atomic_t rec_sigcont;
+static int nproducers;	/* Views drawn as a thread makes their content. */
 
 static void		 fnc_show_version(void);
 static int		 init_curses(void);
@@ -921,10 +1201,22 @@ static int		 open_timeline_view(struct fnc_view *, fsl_id_t,
 static int		 view_loop(struct fnc_view *);
 static int		 show_timeline_view(struct fnc_view *);
 static void		*tl_producer_thread(void *);
+static int		 tl_seek_commits(struct fnc_tl_thread_cx *);
 static int		 block_main_thread_signals(void);
 static int		 build_commits(struct fnc_tl_thread_cx *);
+static bool		 tl_prefetch_wanted(struct fnc_tl_thread_cx *);
+static int		 tl_fts_index(struct fnc_tl_thread_cx *);
+static int		 tl_prefetch_pages(void);
 static int		 commit_builder(struct fnc_commit_artifact **, fsl_id_t,
-			    fsl_stmt *);
+			    fsl_stmt *, struct fnc_arena *);
+static int		 create_tmp_tagmap_table(fsl_db *);
+static int		 create_tmp_fts_table(fsl_db *, int, bool *);
+static int		 tl_open_db(fsl_db **);
+static int		 create_tmp_fnid_table(fsl_db *, const char *);
+static int		 create_tmp_ancestor_table(fsl_db *, fsl_id_t, int);
+static int		 fnc_cx_clone(fsl_cx **);
+static int		 fnc_cx_clone_auth(void *, int, const char *,
+			    const char *, const char *, const char *);
 static int		 signal_tl_thread(struct fnc_view *, int);
 static int		 draw_commits(struct fnc_view *);
 static void		 parse_emailaddr_username(char **);
@@ -934,6 +1226,9 @@ static size_t		 expand_tab(char *, size_t, const char *, int);
 static int		 multibyte_to_wchar(const char *, wchar_t **, size_t *);
 static int		 write_commit_line(struct fnc_view *,
 			    struct fnc_commit_artifact *, int);
+static time_t		 fnc_mtime_to_tm(double, struct tm *);
+static char		*fnc_mtime_to_str(double, char *, size_t);
+static const char	*fnc_date_cache_get(struct fnc_date_cache *, double);
 static int		 view_input(struct fnc_view **, int *,
 			    struct fnc_view *, struct view_tailhead *);
 static int		 cycle_view(struct fnc_view *);
@@ -950,7 +1245,14 @@ static int		 move_tl_cursor_down(struct fnc_view *, uint16_t);
 static void		 move_tl_cursor_up(struct fnc_view *, uint16_t, bool);
 static int		 timeline_scroll_down(struct fnc_view *, int);
 static void		 timeline_scroll_up(struct fnc_tl_view_state *, int);
+static void		 select_commit_entry(struct fnc_view *,
+			    struct commit_entry *);
 static void		 select_commit(struct fnc_tl_view_state *);
+static int		 tl_goto_date(struct fnc_view *);
+static int		 tl_goto_symbol(struct fnc_view *);
+static int		 tl_goto_end(struct fnc_view *);
+static int		 tl_goto_commit(struct fnc_view *,
+			    const struct commit_key *, bool);
 static int		 request_view(struct fnc_view **, struct fnc_view *,
 			    enum fnc_view_id);
 static int		 init_view(struct fnc_view **, struct fnc_view *,
@@ -965,8 +1267,16 @@ static int		 make_fullscreen(struct fnc_view *);
 static int		 view_search_start(struct fnc_view *);
 static void		 tl_grep_init(struct fnc_view *);
 static int		 tl_search_next(struct fnc_view *);
+static int		 tl_search_terms(struct fnc_tl_thread_cx *,
+			    const char *);
+static int		 tl_search_term(fsl_buffer *, fsl_buffer *, bool *,
+			    fsl_buffer *);
+static int		 tl_fts_search(struct fnc_tl_thread_cx *);
+static int		 tl_scan_commits(struct fnc_view *, struct tl_scan *);
+static void		*tl_scan_thread(void *);
 static bool		 find_commit_match(struct fnc_commit_artifact *,
-			    regex_t *);
+			    regex_t *, int, bool);
+static bool		 match_str(const char *, bool, regex_t *, int, bool);
 static int		 init_diff_view(struct fnc_view **, int, int,
 			    struct fnc_commit_artifact *, struct fnc_view *);
 static int		 open_diff_view(struct fnc_view *,
@@ -977,10 +1287,33 @@ static void		 show_diff_status(struct fnc_view *);
 static int		 create_diff(struct fnc_diff_view_state *);
 static int		 create_changeset(struct fnc_commit_artifact *);
 static int		 write_commit_meta(struct fnc_diff_view_state *);
-static int		 wrapline(char *, fsl_size_t ncols_avail,
-			    struct fnc_diff_view_state *, off_t *);
-static int		 add_line_offset(off_t **, size_t *, off_t);
-static int		 diff_commit(struct fnc_diff_view_state *);
+static int		 wrapline(char *, fsl_size_t ncols_avail, fsl_buffer *);
+static int		 add_line_offset(struct fnc_diff_view_state *, off_t);
+static int		 add_diff_lines(struct fnc_diff_view_state *,
+			    const fsl_buffer *, bool);
+static int		 start_diff(struct fnc_diff_view_state *);
+static int		 stop_diff(struct fnc_diff_view_state *, bool);
+static size_t		 diff_cache_max(void);
+static void		 diff_key(struct fnc_diff_view_state *,
+			    struct fnc_diff_key *);
+static bool		 diff_key_eq(const struct fnc_diff_key *,
+			    const struct fnc_diff_key *);
+static int		 diff_cache_get(struct fnc_diff_view_state *,
+			    const struct fnc_diff_key *, bool *);
+static int		 diff_cache_put(struct fnc_diff_view_state *,
+			    const struct fnc_diff_key *);
+static void		 diff_cache_evict(struct fnc_diff_view_state *,
+			    struct fnc_diff_cached *);
+static void		*diff_thread(void *);
+static int		 diff_commit(struct fnc_diff_thread_cx *);
+static int		 add_diff_task(struct fnc_diff_thread_cx *,
+			    const fsl_card_F *, const fsl_card_F *,
+			    fsl_ckout_change_e);
+static int		 run_diff_tasks(struct fnc_diff_thread_cx *);
+static size_t		 diff_tasks_size(const struct fnc_diff_thread_cx *);
+static void		 free_diff_tasks(struct fnc_diff_thread_cx *);
+static void		*diff_worker(void *);
+static int		 diff_tasks(struct fnc_diff_thread_cx *, fsl_cx *);
 static int		 diff_checkout(struct fnc_diff_view_state *);
 static int		 write_diff_meta(fsl_buffer *, const char *,
 			    fsl_uuid_str, const char *, fsl_uuid_str, int,
@@ -990,9 +1323,11 @@ static int		 diff_file(struct fnc_diff_view_state *, fsl_buffer *,
 			    enum fsl_ckout_change_e);
 static int		 diff_non_checkin(fsl_buffer *,
 			    struct fnc_commit_artifact *, int, int, int);
-static int		 diff_file_artifact(struct fnc_diff_view_state *,
-			    fsl_id_t, const fsl_card_F *, const fsl_card_F *,
-			    fsl_ckout_change_e);
+static int		 diff_file_artifact(struct fnc_diff_thread_cx *,
+			    fsl_cx *, struct fnc_diff_task *);
+static int		 diff_output_f_buffer(void *, const void *, fsl_size_t);
+static int		 fetch_diff_task(struct fnc_diff_thread_cx *,
+			    fsl_cx *, struct fnc_diff_task *);
 static int		 show_diff(struct fnc_view *);
 static int		 write_diff(struct fnc_view *, char *);
 static int		 match_line(const char *, regex_t *, size_t,
@@ -1008,8 +1343,9 @@ static int		 set_selected_commit(struct fnc_diff_view_state *,
 			    struct commit_entry *);
 static void		 diff_grep_init(struct fnc_view *);
 static int		 find_next_match(struct fnc_view *);
-static void		 grep_set_view(struct fnc_view *, FILE **, off_t **,
-			    size_t *, int **, int **, int **, int **);
+static void		 grep_set_view(struct fnc_view *, FILE **,
+			    const char **, off_t **, size_t *, int **, int **,
+			    int **, int **);
 static int		 view_close(struct fnc_view *);
 static int		 map_repo_path(char **);
 static int		 init_timeline_view(struct fnc_view **, int, int,
@@ -1119,7 +1455,33 @@ static bool		 screen_is_shared(struct fnc_view *);
 static void		 updatescreen(WINDOW *, bool, bool);
 static void		 fnc_resizeterm(void);
 static int		 join_tl_thread(struct fnc_tl_view_state *);
+static struct commit_entry	*commit_queue_get(struct commit_queue *, int);
+static struct commit_entry	*commit_queue_next(struct commit_queue *,
+				    struct commit_entry *);
+static struct commit_entry	*commit_queue_prev(struct commit_queue *,
+				    struct commit_entry *);
+static struct fnc_arena	*commit_queue_arena(struct commit_queue *);
+static int		 commit_queue_load(struct commit_queue *, int);
+static int		 commit_queue_key(struct commit_queue *, int);
+static int		 commit_queue_prepare(struct commit_queue *, bool);
+static int		 commit_queue_skip(struct commit_queue *,
+			    struct commit_key *, const struct commit_key *,
+			    int);
+static void		 commit_queue_evict(struct commit_queue *, int);
+static void		 tl_trim_commits(struct fnc_tl_view_state *);
+static int		 tl_commit_window(void);
+static int		 commit_queue_append(struct commit_queue *,
+			    struct fnc_commit_artifact *);
 static void		 fnc_free_commits(struct commit_queue *);
+static void		*fnc_arena_alloc(struct fnc_arena *, size_t);
+static char		*fnc_arena_strdup(struct fnc_arena *, const char *);
+static char		*fnc_arena_intern(struct fnc_arena *, const char *);
+static void		 fnc_arena_free(struct fnc_arena *);
+static int		 fnc_hash_decode(struct fnc_hash *, const char *);
+static int		 fnc_hash_from_rid(struct fnc_hash *, fsl_id_t);
+static char		*fnc_hash_hex(const struct fnc_hash *, char *);
+static bool		 fnc_hash_eq(const struct fnc_hash *,
+			    const struct fnc_hash *);
 static void		 fnc_commit_artifact_close(struct fnc_commit_artifact*);
 static int		 fsl_file_artifact_free(void *, void *);
 static void		 sigwinch_handler(int);
@@ -1147,6 +1509,9 @@ static int		 init_colour(enum fnc_opt_id);
 static int		 default_colour(enum fnc_opt_id);
 static void		 free_colours(struct fnc_colours *);
 static bool		 fnc_home(struct fnc_view *);
+static void		 start_polling(bool *);
+static void		 stop_polling(bool *);
+static void		 reset_input_mode(void);
 static char		*fnc_conf_getopt(enum fnc_opt_id, bool);
 static int		 fnc_conf_setopt(enum fnc_opt_id, const char *, bool);
 static int		 fnc_conf_lsopt(bool);
@@ -1649,10 +2014,13 @@ open_timeline_view(struct fnc_view *view, fsl_id_t rid, const char *path,
 	fsl_cx				*const f = fcli_cx();
 	fsl_db				*db = fsl_cx_db_repo(f);
 	fsl_buffer			 sql = fsl_buffer_empty;
+	fsl_buffer			 filter = fsl_buffer_empty;
+	fsl_buffer			 resume = fsl_buffer_empty;
+	fsl_buffer			 keys = fsl_buffer_empty;
 	char				*startdate = NULL;
 	char				*op = NULL, *str = NULL;
-	fsl_id_t			 idtag = 0;
-	int				 idx, rc = FSL_RC_OK;
+	fsl_id_t			 idtag = 0, root = 0;
+	int				 idx, n, rc = FSL_RC_OK;
 
 	if (path != s->path) {
 		fsl_free(s->path);
@@ -1661,21 +2029,31 @@ open_timeline_view(struct fnc_view *view, fsl_id_t rid, const char *path,
 			return RC(FSL_RC_ERROR, "%s", "fsl_strdup");
 	}
 
-	/*
-	 * TODO: See about opening this API.
-	 * If a path has been supplied, create a table of all path's
-	 * ancestors and add "AND blob.rid IN fsl_computed_ancestors" to query.
-	 */
-	/* if (path[1]) { */
-	/*	rc = fsl_compute_ancestors(db, rid, 0, 0); */
-	/*	if (rc) */
-	/*		return RC(FSL_RC_DB, "%s", "fsl_compute_ancestors"); */
-	/* } */
 	s->thread_cx.q = NULL;
+	s->thread_cx.db = NULL;
+	s->thread_cx.fts_sql = NULL;
+	s->thread_cx.fts_match = NULL;
+	s->thread_cx.fts_glob = NULL;
+	s->thread_cx.fts_q = NULL;
+	s->thread_cx.search_rid = 0;
+	s->thread_cx.search_fts = false;
+	s->thread_cx.fts_done = false;
+	s->thread_cx.nofts = false;
+	s->thread_cx.seek_idx = -1;
 	/* s->selected_idx = 0; */	/* Unnecessary? */
 
-	TAILQ_INIT(&s->commits.head);
+	s->commits.chunks = NULL;
+	s->commits.keys = NULL;
+	s->commits.refetch = NULL;
+	s->commits.skip = NULL;
+	s->commits.rskip = NULL;
+	s->commits.rank = NULL;
+	s->commits.resume = NULL;
+	s->commits.keyset = NULL;
+	s->commits.nchunks = 0;
 	s->commits.ncommits = 0;
+	s->commits.grown = false;
+	s->diff_idx = -1;
 
 	if (rid)
 		startdate = fsl_mprintf("(SELECT mtime FROM event "
@@ -1729,22 +2107,25 @@ open_timeline_view(struct fnc_view *view, fsl_id_t rid, const char *path,
 	}
 
 	fsl_buffer_appendf(&sql, "SELECT "
-	    /* 0 */"uuid, "
-	    /* 1 */"datetime(event.mtime%s), "
-	    /* 2 */"coalesce(euser, user), "
-	    /* 3 */"rid AS rid, "
-	    /* 4 */"event.type AS eventtype, "
-	    /* 5 */"(SELECT group_concat(substr(tagname,5), ',') "
-	    "FROM tag, tagxref WHERE tagname GLOB 'sym-*' "
-	    "AND tag.tagid=tagxref.tagid AND tagxref.rid=blob.rid "
-	    "AND tagxref.tagtype > 0) as tags, "
-	    /*6*/"coalesce(ecomment, comment) AS comment FROM event JOIN blob "
-	    "WHERE blob.rid=event.objid", fnc_init.utc ? "" : ", 'localtime'");
+	    /* 0 */"blob.uuid, "
+	    /* 1 */"coalesce(euser, user), "
+	    /* 2 */"blob.rid AS rid, "
+	    /* 3 */"event.type AS eventtype, "
+	    /* 4 */"tmp_tagmap.tags AS tags, "
+	    /*5*/"coalesce(ecomment, comment) AS comment, "
+	    /* 6 */"event.mtime AS mtime, "
+	    /* 7 */"pblob.uuid AS puuid, "
+	    /* 8 */"plink.pid AS prid "
+	    "FROM event JOIN blob LEFT JOIN plink "
+	    "ON plink.cid=blob.rid AND plink.isprim "
+	    "LEFT JOIN blob AS pblob ON pblob.rid=plink.pid "
+	    "LEFT JOIN tmp_tagmap ON tmp_tagmap.rid=blob.rid "
+	    "WHERE blob.rid=event.objid");
 
 	if (fnc_init.filter_types.nitems) {
-		fsl_buffer_appendf(&sql, " AND (");
+		fsl_buffer_appendf(&filter, " AND (");
 		for (idx = 0; idx < fnc_init.filter_types.nitems; ++idx)
-			fsl_buffer_appendf(&sql, " eventtype=%Q%s",
+			fsl_buffer_appendf(&filter, " eventtype=%Q%s",
 			    fnc_init.filter_types.values[idx], (idx + 1) <
 			    fnc_init.filter_types.nitems ? " OR " : ")");
 	}
@@ -1758,7 +2139,7 @@ open_timeline_view(struct fnc_view *view, fsl_id_t rid, const char *path,
 		    "SELECT tagid FROM tag WHERE tagname %q 'sym-%q'"
 		    " ORDER BY tagid DESC", op, str);
 		if (idtag) {
-			rc = fsl_buffer_appendf(&sql,
+			rc = fsl_buffer_appendf(&filter,
 			    " AND EXISTS(SELECT 1 FROM tagxref"
 			    " WHERE tagid=%"FSL_ID_T_PFMT
 			    " AND tagtype > 0 AND rid=blob.rid)", idtag);
@@ -1785,7 +2166,7 @@ open_timeline_view(struct fnc_view *view, fsl_id_t rid, const char *path,
 			    "SELECT tagid FROM tag WHERE tagname %q 'sym-%q'"
 			    " ORDER BY tagid DESC", op, str);
 		if (idtag) {
-			rc = fsl_buffer_appendf(&sql,
+			rc = fsl_buffer_appendf(&filter,
 			    " AND EXISTS(SELECT 1 FROM tagxref"
 			    " WHERE tagid=%"FSL_ID_T_PFMT
 			    " AND tagtype > 0 AND rid=blob.rid)", idtag);
@@ -1803,7 +2184,7 @@ open_timeline_view(struct fnc_view *view, fsl_id_t rid, const char *path,
 		    !fnc_str_has_upper(fnc_init.filter_user));
 		if (rc)
 			goto end;
-		rc = fsl_buffer_appendf(&sql,
+		rc = fsl_buffer_appendf(&filter,
 		    " AND coalesce(euser, user) %q '%q'", op, str);
 		if (rc)
 			goto end;
@@ -1818,12 +2199,12 @@ open_timeline_view(struct fnc_view *view, fsl_id_t rid, const char *path,
 		idtag = fsl_db_g_id(db, 0,
 		    "SELECT tagid FROM tag WHERE tagname %q 'sym-%q'"
 		    " ORDER BY tagid DESC", op, str);
-		rc = fsl_buffer_appendf(&sql,
+		rc = fsl_buffer_appendf(&filter,
 		    " AND (coalesce(ecomment, comment) %q %Q"
 		    " OR coalesce(euser, user) %q %Q%c",
 		    op, str, op, str, idtag ? ' ' : ')');
 		if (!rc && idtag > 0)
-			rc = fsl_buffer_appendf(&sql,
+			rc = fsl_buffer_appendf(&filter,
 			    " OR EXISTS(SELECT 1 FROM tagxref"
 			    " WHERE tagid=%"FSL_ID_T_PFMT
 			    " AND tagtype > 0 AND rid=blob.rid))", idtag);
@@ -1832,38 +2213,101 @@ open_timeline_view(struct fnc_view *view, fsl_id_t rid, const char *path,
 	}
 
 	if (startdate) {
-		fsl_buffer_appendf(&sql, " AND event.mtime <= %s", startdate);
+		fsl_buffer_appendf(&filter, " AND event.mtime <= %s",
+		    startdate);
 		fsl_free(startdate);
 	}
 
+	/*
+	 * Only retrieve the ancestors of the start commit, or else of the
+	 * checkout or tip, so that events on unrelated branches are never
+	 * visited; see create_tmp_ancestor_table().
+	 */
+	if (fnc_init.ancestors) {
+		root = rid;
+		if (root == 0)
+			fsl_ckout_version_info(f, &root, NULL);
+		if (root == 0 && (fsl_sym_to_rid(f, "tip",
+		    FSL_SATYPE_CHECKIN, &root) || root == 0)) {
+			rc = RC(FSL_RC_NOT_FOUND, "%s",
+			    "no check-in to find the ancestors of");
+			goto end;
+		}
+		rc = fsl_buffer_appendf(&filter, " AND blob.rid IN (SELECT rid"
+		    " FROM tmp_ancestor WHERE root=%"FSL_ID_T_PFMT")", root);
+		if (rc) {
+			rc = RC(rc, "%s", "fsl_buffer_appendf");
+			goto end;
+		}
+	}
+
 	/*
 	 * If path is not root ("/"), a versioned path in the repository has
-	 * been requested, only retrieve commits involving path.
+	 * been requested, only retrieve commits involving path. Unless path
+	 * changed in too many commits to sort up front, drive the query from
+	 * the mlink rows of its fnids to their events rather than test every
+	 * event in mtime order for one.
 	 */
 	if (path[1]) {
-		fsl_buffer_appendf(&sql,
-		    " AND EXISTS(SELECT 1 FROM mlink"
-		    " WHERE mlink.mid = event.objid"
-		    " AND mlink.fnid IN ");
-		if (fsl_cx_is_case_sensitive(f,false)) {
-			fsl_buffer_appendf(&sql,
-			    "(SELECT fnid FROM filename"
-			    " WHERE name = %Q OR name GLOB '%q/*')",
-			    path + 1, path + 1);  /* Skip prepended slash. */
-		} else {
-			fsl_buffer_appendf(&sql,
-			    "(SELECT fnid FROM filename"
-			    " WHERE name = %Q COLLATE nocase"
-			    " OR lower(name) GLOB lower('%q/*'))",
-			    path + 1, path + 1);  /* Skip prepended slash. */
+		rc = create_tmp_fnid_table(db, path + 1);  /* Skip slash. */
+		if (rc)
+			goto end;
+		n = fsl_db_g_int32(db, 0, "SELECT count(*) FROM"
+		    " (SELECT 1 FROM mlink WHERE fnid IN"
+		    " (SELECT fnid FROM tmp_fnid WHERE path=%Q) LIMIT %d)",
+		    path + 1, TL_PATH_SORT_MAX + 1);
+		if (n <= TL_PATH_SORT_MAX)
+			rc = fsl_buffer_appendf(&filter, " AND event.objid IN"
+			    " (SELECT mid FROM mlink WHERE fnid IN"
+			    " (SELECT fnid FROM tmp_fnid WHERE path=%Q))",
+			    path + 1);
+		else
+			rc = fsl_buffer_appendf(&filter,
+			    " AND EXISTS(SELECT 1 FROM mlink"
+			    " WHERE mlink.mid = event.objid AND mlink.fnid IN"
+			    " (SELECT fnid FROM tmp_fnid WHERE path=%Q))",
+			    path + 1);
+		if (rc) {
+			rc = RC(rc, "%s", "fsl_buffer_appendf");
+			goto end;
 		}
-		fsl_buffer_append(&sql, ")", 1);
 	}
 
-	fsl_buffer_appendf(&sql, " ORDER BY event.mtime DESC");
-
-	if (fnc_init.nrecords.limit > 0)
-		fsl_buffer_appendf(&sql, " LIMIT %d", fnc_init.nrecords.limit);
+	/*
+	 * Keep the timeline query in (mtime, rid) order so it can be resumed
+	 * from any commit with an index seek on event.mtime; see
+	 * commit_queue_load() and tl_seek_commits(). The keys of commits that
+	 * are skipped over are found with a leaner query on the same filter
+	 * clauses that doesn't join what only building a commit needs.
+	 */
+	rc = fsl_buffer_appendf(&sql, "%b", &filter);
+	if (!rc)
+		rc = fsl_buffer_appendf(&resume, "%b AND event.mtime <= ?1"
+		    " AND (event.mtime < ?1 OR event.objid < ?2)"
+		    " ORDER BY event.mtime DESC, event.objid DESC%s", &sql,
+		    fnc_init.nrecords.limit > 0 ? " LIMIT ?3" : "");
+	if (!rc)
+		rc = fsl_buffer_appendf(&keys, "SELECT event.mtime,"
+		    " event.objid, event.type AS eventtype FROM event JOIN blob"
+		    " WHERE blob.rid=event.objid%b", &filter);
+	/*
+	 * Forward searches past the last loaded commit take their candidates
+	 * from tmp_fts; see tl_fts_search(). With a record limit, a candidate
+	 * could be past the end of the timeline, so stream those instead.
+	 */
+	if (!rc && fnc_init.nrecords.limit <= 0) {
+		s->thread_cx.fts_sql = fsl_mprintf("%b AND event.mtime <= ?1"
+		    " AND (event.mtime < ?1 OR event.objid < ?2)"
+		    " AND (blob.rid IN (SELECT rowid FROM tmp_fts"
+		    " WHERE tmp_fts MATCH ?3) OR blob.uuid GLOB ?4)"
+		    " ORDER BY event.mtime DESC, event.objid DESC", &sql);
+		if (s->thread_cx.fts_sql == NULL)
+			rc = FSL_RC_OOM;
+	}
+	if (rc) {
+		rc = RC(rc, "%s", "fsl_buffer_appendf");
+		goto end;
+	}
 
 	view->show = show_timeline_view;
 	view->input = tl_input_handler;
@@ -1871,10 +2315,58 @@ open_timeline_view(struct fnc_view *view, fsl_id_t rid, const char *path,
 	view->grep_init = tl_grep_init;
 	view->grep = tl_search_next;
 
+	/*
+	 * The timeline thread steps its query on a connection of its own so
+	 * that it neither contends with nor is reset by the stmts that child
+	 * views run on the fsl_cx connection.
+	 */
+	rc = tl_open_db(&s->thread_cx.db);
+	if (!rc && path[1])
+		rc = create_tmp_fnid_table(s->thread_cx.db, path + 1);
+	if (!rc && root)
+		rc = create_tmp_ancestor_table(s->thread_cx.db, root,
+		    fnc_init.nrecords.limit);
+	if (rc)
+		goto end;
+	/*
+	 * Create tmp_fts before the query is stepped, as SQLite aborts a
+	 * running stmt with a correlated subquery, such as that of a path
+	 * filter, if the schema changes; tl_fts_index() then only inserts.
+	 */
+	if (s->thread_cx.fts_sql) {
+		bool done;
+
+		if (create_tmp_fts_table(s->thread_cx.db, 0, &done)) {
+			fsl_db_err_reset(s->thread_cx.db);
+			fcli_err_reset();
+			s->thread_cx.nofts = true;
+		}
+	}
+	/* Start from the top: no commit is after the largest key. */
 	s->thread_cx.q = fsl_stmt_malloc();
-	rc = fsl_db_prepare(db, s->thread_cx.q, "%b", &sql);
+	rc = fsl_db_prepare(s->thread_cx.db, s->thread_cx.q, "%b", &resume);
 	if (rc) {
-		rc = RC(rc, "%s", "fsl_db_prepare");
+		rc = RC(fsl_cx_uplift_db_error2(f, s->thread_cx.db, rc),
+		    "%s", "fsl_db_prepare");
+		goto end;
+	}
+	rc = fsl_stmt_bind_double(s->thread_cx.q, 1, DBL_MAX);
+	if (!rc)
+		rc = fsl_stmt_bind_id(s->thread_cx.q, 2, 0);
+	if (!rc && fnc_init.nrecords.limit > 0)
+		rc = fsl_stmt_bind_int32(s->thread_cx.q, 3,
+		    fnc_init.nrecords.limit);
+	if (rc) {
+		rc = RC(rc, "%s", "fsl_stmt_bind");
+		goto end;
+	}
+	/* The stmts on this connection are prepared when first needed. */
+	s->commits.window = tl_commit_window();
+	s->commits.root = root;
+	s->commits.resume = fsl_buffer_take(&resume);
+	s->commits.keyset = fsl_buffer_take(&keys);
+	if (s->commits.resume == NULL || s->commits.keyset == NULL) {
+		rc = RC(FSL_RC_OOM, "%s", "fsl_buffer_take");
 		goto end;
 	}
 	rc = fsl_stmt_step(s->thread_cx.q);
@@ -1892,9 +2384,9 @@ open_timeline_view(struct fnc_view *view, fsl_id_t rid, const char *path,
 
 	s->colour = !fnc_init.nocolour && has_colors();
 	s->thread_cx.rc = 0;
-	s->thread_cx.db = db;
 	s->thread_cx.spin_idx = 0;
 	s->thread_cx.ncommits_needed = view->nlines - 1;
+	s->prefetch_pages = tl_prefetch_pages();
 	s->thread_cx.commits = &s->commits;
 	s->thread_cx.eotl = false;
 	s->thread_cx.quit = &s->quit;
@@ -1904,7 +2396,6 @@ open_timeline_view(struct fnc_view *view, fsl_id_t rid, const char *path,
 	s->thread_cx.search_status = &view->search_status;
 	s->thread_cx.regex = &view->regex;
 	s->thread_cx.path = s->path;
-	s->thread_cx.reset = true;
 
 	if (s->colour) {
 		STAILQ_INIT(&s->colours);
@@ -1912,6 +2403,9 @@ open_timeline_view(struct fnc_view *view, fsl_id_t rid, const char *path,
 	}
 end:
 	fsl_buffer_clear(&sql);
+	fsl_buffer_clear(&filter);
+	fsl_buffer_clear(&resume);
+	fsl_buffer_clear(&keys);
 	fsl_free(op);
 	fsl_free(str);
 	if (rc) {
@@ -2068,9 +2562,163 @@ show_timeline_view(struct fnc_view *view)
 		}
 	}
 
+	/*
+	 * Keep the read-ahead window sized to the view, and wake the timeline
+	 * thread if it has fallen short, e.g., because we scrolled into it.
+	 */
+	s->thread_cx.nprefetch = (s->prefetch_pages + 1) * (view->nlines - 1);
+	tl_trim_commits(s);
+	if (!s->thread_cx.ncommits_needed &&
+	    tl_prefetch_wanted(&s->thread_cx)) {
+		if ((rc = pthread_cond_signal(&s->thread_cx.commit_consumer)))
+			return RC(fsl_errno_to_rc(rc, FSL_RC_MISUSE),
+			    "%s", "pthread_cond_signal");
+	}
+
 	return draw_commits(view);
 }
 
+/*
+ * Return true if the timeline thread should read ahead because fewer than
+ * nprefetch commits are loaded from the first commit on screen. Caller must
+ * hold fnc_mutex.
+ */
+static bool
+tl_prefetch_wanted(struct fnc_tl_thread_cx *cx)
+{
+	struct commit_entry	*first = *cx->first_commit_onscreen;
+
+	return first != NULL && !cx->eotl &&
+	    cx->commits->ncommits < first->idx + cx->nprefetch;
+}
+
+/*
+ * Return the number of pages the timeline thread should load ahead of the
+ * view. If FNC_PREFETCH_PAGES is set to a valid value 0 <= n <= MAX_PREFETCH,
+ * return n, else return PREFETCH_PAGES.
+ */
+static int
+tl_prefetch_pages(void)
+{
+	char	*pages = NULL;
+	long	 n = PREFETCH_PAGES;
+	int	 rc = FSL_RC_OK;
+
+	pages = fnc_conf_getopt(FNC_PREFETCH_PAGES, false);
+	if (pages)
+		rc = strtonumcheck(&n, pages, 0, MAX_PREFETCH);
+
+	fsl_free(pages);
+	return rc ? PREFETCH_PAGES : n;
+}
+
+/*
+ * Return the number of commits to keep loaded either side of the view as set
+ * with FNC_TIMELINE_WINDOW, or 0 to keep every commit loaded if it's not set
+ * or invalid.
+ */
+static int
+tl_commit_window(void)
+{
+	char	*window = NULL;
+	long	 n = 0;
+	int	 rc = FSL_RC_OK;
+
+	window = fnc_conf_getopt(FNC_TIMELINE_WINDOW, false);
+	if (window)
+		rc = strtonumcheck(&n, window, 0, MAX_TL_WINDOW);
+
+	fsl_free(window);
+	return rc ? 0 : n;
+}
+
+/*
+ * In windowed mode, evict each chunk of commits that is not within the window
+ * either side of the view, nor holds the last commit, nor holds a commit that
+ * the view's search state or diff view refers to. This only does any work
+ * after a chunk has been loaded, which bounds the number resident. Caller
+ * must hold fnc_mutex.
+ */
+static void
+tl_trim_commits(struct fnc_tl_view_state *s)
+{
+	struct commit_queue	*q = &s->commits;
+	int			 keep[3], chunk, lo, hi, last, n;
+
+	if (!q->window || !q->grown || s->first_commit_onscreen == NULL)
+		return;
+	q->grown = false;
+
+	lo = MAX(s->first_commit_onscreen->idx - q->window, 0) >>
+	    COMMIT_CHUNK_SHIFT;
+	hi = (s->last_commit_onscreen ? s->last_commit_onscreen->idx :
+	    s->first_commit_onscreen->idx) + MAX(q->window,
+	    s->thread_cx.nprefetch);
+	hi >>= COMMIT_CHUNK_SHIFT;
+	last = (q->ncommits - 1) >> COMMIT_CHUNK_SHIFT;
+
+	n = 0;
+	if (s->matched_commit)
+		keep[n++] = s->matched_commit->idx >> COMMIT_CHUNK_SHIFT;
+	if (s->search_commit)
+		keep[n++] = s->search_commit->idx >> COMMIT_CHUNK_SHIFT;
+	if (s->diff_idx >= 0)
+		keep[n++] = s->diff_idx >> COMMIT_CHUNK_SHIFT;
+
+	for (chunk = 0; chunk < last; ++chunk) {
+		int	i;
+
+		if (q->chunks[chunk] == NULL || (chunk >= lo && chunk <= hi))
+			continue;
+		for (i = 0; i < n && keep[i] != chunk; ++i)
+			;
+		if (i == n)
+			commit_queue_evict(q, chunk);
+	}
+}
+
+/*
+ * Add the next TL_FTS_BATCH events to the tmp_fts index on the timeline
+ * thread's connection. This is done while the thread is otherwise idle so
+ * the first search doesn't wait on indexing the whole repository, and in
+ * batches so loading commits doesn't wait long on it either. Must be called
+ * with fnc_mutex held, which is released while events are indexed. If the
+ * index can't be built, search falls back to loading and matching commits.
+ */
+static int
+tl_fts_index(struct fnc_tl_thread_cx *cx)
+{
+	int	rc, err;
+	bool	done = false;
+
+	if ((err = pthread_mutex_unlock(&fnc_mutex)))
+		return RC(fsl_errno_to_rc(err, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_unlock");
+	rc = create_tmp_fts_table(cx->db, TL_FTS_BATCH, &done);
+	if (rc)
+		fsl_db_err_reset(cx->db);
+	if ((err = pthread_mutex_lock(&fnc_mutex)))
+		return RC(fsl_errno_to_rc(err, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_lock");
+	if (rc) {
+		cx->nofts = true;
+		fcli_err_reset();
+	} else
+		cx->fts_done = done;
+
+	return 0;
+}
+
+/*
+ * The timeline thread holds fnc_mutex except while it steps the commit builder
+ * stmt and builds commits, so the main thread can process input while commits
+ * are being loaded. Commits are published in batches so the mutex is taken
+ * once per batch rather than per commit. Besides the ncommits_needed that the
+ * main thread asks for and waits on, it reads ahead in the background while
+ * there are fewer than nprefetch commits loaded from the first commit on
+ * screen so that paging down doesn't wait on the database. When the main
+ * thread jumps far ahead, it skips to there instead; see tl_seek_commits().
+ */
 static void *
 tl_producer_thread(void *state)
 {
@@ -2082,7 +2730,39 @@ tl_producer_thread(void *state)
 	if (rc)
 		return (void *)(intptr_t)rc;
 
+	if ((rc = pthread_mutex_lock(&fnc_mutex)))
+		return (void *)(intptr_t)RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_lock");
+
 	while (!done && !rc && !rec_sigpipe) {
+		while (!*cx->quit && !cx->ncommits_needed &&
+		    !tl_prefetch_wanted(cx) && (cx->fts_done || cx->nofts ||
+		    cx->fts_sql == NULL)) {
+			if ((rc = pthread_cond_wait(&cx->commit_consumer,
+			    &fnc_mutex))) {
+				rc = RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+				    "%s", "pthread_cond_wait");
+				break;
+			}
+		}
+		if (rc || *cx->quit)
+			break;
+
+		/* When idle, index the timeline for search a bit at a time. */
+		if (!cx->ncommits_needed && !tl_prefetch_wanted(cx)) {
+			rc = tl_fts_index(cx);
+			continue;
+		}
+
+		/* Chunks are never partly loaded, so seek once one is full. */
+		if (cx->seek_idx >= 0 &&
+		    (cx->commits->ncommits & COMMIT_CHUNK_MASK) == 0) {
+			if ((rc = tl_seek_commits(cx))) {
+				cx->rc = rc;
+				break;
+			}
+		}
+
 		switch (rc = build_commits(cx)) {
 		case FSL_RC_STEP_DONE:
 			done = true;
@@ -2091,53 +2771,78 @@ tl_producer_thread(void *state)
 			rc = 0;
 			/* FALL THROUGH */
 		default:
-			if (rc) {
+			if (rc)
 				cx->rc = rc;
-				return (void *)(intptr_t)rc;
-			}
-			else if (cx->ncommits_needed > 0)
-				cx->ncommits_needed--;
 			break;
 		}
-
-		if ((rc = pthread_mutex_lock(&fnc_mutex))) {
-			rc = RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
-			    "%s", "pthread_mutex_lock");
+		if (rc)
 			break;
-		} else if (*cx->first_commit_onscreen == NULL) {
+
+		if (*cx->first_commit_onscreen == NULL) {
 			*cx->first_commit_onscreen =
-			    TAILQ_FIRST(&cx->commits->head);
+			    commit_queue_get(cx->commits, 0);
 			*cx->selected_commit = *cx->first_commit_onscreen;
-		} else if (*cx->quit)
-			done = true;
+		}
+		if (done)
+			cx->ncommits_needed = 0;
 
 		if ((rc = pthread_cond_signal(&cx->commit_producer))) {
 			rc = RC(fsl_errno_to_rc(rc, FSL_RC_MISUSE),
 			    "%s", "pthread_cond_signal");
-			pthread_mutex_unlock(&fnc_mutex);
 			break;
 		}
 
-		if (done)
-			cx->ncommits_needed = 0;
-		else if (cx->ncommits_needed == 0) {
-			if ((rc = pthread_cond_wait(&cx->commit_consumer,
-			    &fnc_mutex)))
-				rc = RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
-				    "%s", "pthread_cond_wait");
-			if (*cx->quit)
-				done = true;
-		}
-
-		if ((rc = pthread_mutex_unlock(&fnc_mutex)))
-			rc = RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
-			    "%s", "pthread_mutex_unlock");
 	}
 
 	cx->eotl = true;
+	/* Don't leave the main thread waiting on commits that won't come. */
+	pthread_cond_signal(&cx->commit_producer);
+	pthread_mutex_unlock(&fnc_mutex);
 	return (void *)(intptr_t)rc;
 }
 
+/*
+ * Skip the timeline query over the commits before the chunk of the one that
+ * the main thread asked for with cx->seek_idx, and reposition it at the first
+ * commit in that chunk, cx->seek_key. The chunks skipped over are left to be
+ * loaded on demand by commit_queue_load(). Must be called with fnc_mutex held
+ * and the last chunk full.
+ */
+static int
+tl_seek_commits(struct fnc_tl_thread_cx *cx)
+{
+	struct commit_queue	*commits = cx->commits;
+	int			 idx, rc;
+
+	idx = cx->seek_idx & ~COMMIT_CHUNK_MASK;
+	cx->seek_idx = -1;
+
+	/* Skipped commits no longer count toward what's needed. */
+	cx->ncommits_needed = MAX(cx->ncommits_needed -
+	    (idx - commits->ncommits), 0);
+	commits->ncommits = idx;
+	if (commit_queue_arena(commits) == NULL)
+		return RC(FSL_RC_OOM, "%s", "commit_queue_arena");
+	commits->keys[idx >> COMMIT_CHUNK_SHIFT] = cx->seek_key;
+
+	/* Inclusive of the first commit: objid < rid + 1. */
+	fsl_stmt_reset(cx->q);
+	rc = fsl_stmt_bind_double(cx->q, 1, cx->seek_key.mtime);
+	if (!rc)
+		rc = fsl_stmt_bind_id(cx->q, 2, cx->seek_key.rid + 1);
+	if (!rc && fnc_init.nrecords.limit > 0)
+		rc = fsl_stmt_bind_int32(cx->q, 3,
+		    fnc_init.nrecords.limit - idx);
+	if (rc)
+		return RC(rc, "%s", "fsl_stmt_bind");
+
+	rc = fsl_stmt_step(cx->q);
+	if (rc == FSL_RC_STEP_ROW)
+		return FSL_RC_OK;
+	return RC(rc == FSL_RC_STEP_DONE ? FSL_RC_NOT_FOUND : rc, "%s",
+	    "timeline changed since loaded");
+}
+
 static int
 block_main_thread_signals(void)
 {
@@ -2167,122 +2872,173 @@ block_main_thread_signals(void)
 	return FSL_RC_OK;
 }
 
+/*
+ * Build the next batch of commits, or if searching forward, batches until one
+ * matches, into the timeline. Must be called with fnc_mutex held, which is
+ * released while the stmt on the timeline thread's own connection is stepped
+ * and each batch is built, then retaken once to publish the whole batch to
+ * the queue. A batch is sized to what the main thread is waiting on or
+ * reading ahead for, up to TL_BATCH_MAX, and never spans chunks: the tail
+ * chunk that commits are built in is never evicted, so its arena is safe to
+ * use unlocked.
+ */
 static int
 build_commits(struct fnc_tl_thread_cx *cx)
 {
-	int	rc = 0;
+	struct fnc_commit_artifact	*batch[TL_BATCH_MAX];
+	int				 rc = 0, err;
 
-	if (cx->reset && cx->commits->ncommits) {
-		/*
-		 * If a child view was opened, there may be cached stmts that
-		 * necessitate resetting the commit builder stmt. Otherwise one
-		 * of the APIs down the fsl_stmt_step() call stack fails;
-		 * irrespective of whether fsl_db_prepare_cached() was used.
-		 */
-		fsl_size_t loaded = cx->commits->ncommits + 1;
-		cx->reset = false;
-		rc = fsl_stmt_reset(cx->q);
-		if (rc)
-			return RC(rc, "%s", "fsl_stmt_reset");
-		while (loaded--)
-			if ((rc = fsl_stmt_step(cx->q)) != FSL_RC_STEP_ROW)
-				return RC(rc, "%s", "fsl_stmt_step");
-	}
 	/*
 	 * Step through the given SQL query, passing each row to the commit
 	 * builder to build commits for the timeline.
 	 */
 	do {
-		struct fnc_commit_artifact	*commit = NULL;
-		struct commit_entry		*dup_entry, *entry;
+		struct fnc_arena	*arena;
+		struct commit_entry	*first;
+		int			 i, n, nbuilt = 0;
+		bool			 failed = false;
 
-		rc = commit_builder(&commit, 0, cx->q);
-		if (rc)
-			return RC(rc, "%s", "commit_builder");
-		/*
-		 * TODO: Find out why, without this, fnc reads and displays
-		 * the first (i.e., latest) commit twice. This hack checks to
-		 * see if the current row returned a UUID matching the last
-		 * commit added to the list to avoid adding a duplicate entry.
-		 */
-		dup_entry = TAILQ_FIRST(&cx->commits->head);
-		if (cx->commits->ncommits == 1 &&
-		    !fsl_strcmp(dup_entry->commit->uuid, commit->uuid)) {
-			fnc_commit_artifact_close(commit);
-			cx->ncommits_needed++;
-			continue;
+		if (cx->search_fts) {
+			rc = tl_fts_search(cx);
+			if (rc)
+				return rc;
+			/* No match ahead, so no need to load any more. */
+			if (cx->search_rid < 0) {
+				cx->ncommits_needed = 0;
+				return FSL_RC_STEP_ROW;
+			}
 		}
 
-		entry = fsl_malloc(sizeof(*entry));
-		if (entry == NULL)
-			return RC(FSL_RC_ERROR, "%s", "fsl_malloc");
+		arena = commit_queue_arena(cx->commits);
+		if (arena == NULL)
+			return RC(FSL_RC_OOM, "%s", "commit_queue_arena");
 
-		entry->commit = commit;
+		n = cx->ncommits_needed;
+		first = *cx->first_commit_onscreen;
+		if (first != NULL)
+			n = MAX(n, first->idx + cx->nprefetch -
+			    cx->commits->ncommits);
+		if (*cx->searching == SEARCH_FORWARD &&
+		    *cx->search_status == SEARCH_WAITING)
+			n = TL_BATCH_MAX;
+		n = MIN(MAX(n, 1), MIN(TL_BATCH_MAX, COMMIT_CHUNK_SZ -
+		    (cx->commits->ncommits & COMMIT_CHUNK_MASK)));
 
-		rc = pthread_mutex_lock(&fnc_mutex);
-		if (rc)
+		if ((rc = pthread_mutex_unlock(&fnc_mutex)))
 			return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
-			    "%s", "pthread_mutex_lock");
-
-		entry->idx = cx->commits->ncommits;
-		TAILQ_INSERT_TAIL(&cx->commits->head, entry, entries);
-		cx->commits->ncommits++;
-
-		if (!cx->endjmp && *cx->searching == SEARCH_FORWARD &&
-		    *cx->search_status == SEARCH_WAITING) {
-			if (find_commit_match(commit, cx->regex))
-				*cx->search_status = SEARCH_CONTINUE;
-		}
+			    "%s", "pthread_mutex_unlock");
+		do {
+			struct fnc_commit_artifact	*commit = NULL;
+			struct commit_entry		*dup_entry;
 
-		rc = pthread_mutex_unlock(&fnc_mutex);
-		if (rc)
-			return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
-			    "%s", "pthread_mutex_unlock");
+			rc = commit_builder(&commit, 0, cx->q, arena);
+			if (rc) {
+				failed = true;
+				break;
+			}
+			/*
+			 * TODO: Find out why, without this, fnc reads and
+			 * displays the first (i.e., latest) commit twice. This
+			 * hack checks to see if the current row returned a
+			 * UUID matching the last commit added to the list to
+			 * avoid adding a duplicate entry. Entry 0 is in the
+			 * tail chunk, so it's safe to read unlocked.
+			 */
+			if (cx->commits->ncommits + nbuilt == 1 &&
+			    (dup_entry = commit_queue_get(cx->commits, 0)) &&
+			    fnc_hash_eq(&dup_entry->commit->uuid,
+			    &commit->uuid)) {
+				fnc_commit_artifact_close(commit);
+				continue;
+			}
+			batch[nbuilt++] = commit;
+		} while ((rc = fsl_stmt_step(cx->q)) == FSL_RC_STEP_ROW &&
+		    nbuilt < n);
+		if ((err = pthread_mutex_lock(&fnc_mutex)))
+			rc = RC(fsl_errno_to_rc(err, FSL_RC_ACCESS),
+			    "%s", "pthread_mutex_lock");
+		else if (failed)
+			rc = RC(rc, "%s", "commit_builder");
+		if (rc != FSL_RC_STEP_ROW && rc != FSL_RC_STEP_DONE) {
+			while (nbuilt--)
+				fnc_commit_artifact_close(batch[nbuilt]);
+			return rc;
+		}
 
-	} while ((rc = fsl_stmt_step(cx->q)) == FSL_RC_STEP_ROW
-	    && *cx->searching == SEARCH_FORWARD
-	    && *cx->search_status == SEARCH_WAITING);
+		/* Publish the batch. */
+		for (i = 0; i < nbuilt; ++i) {
+			if ((err = commit_queue_append(cx->commits,
+			    batch[i]))) {
+				while (i < nbuilt)
+					fnc_commit_artifact_close(batch[i++]);
+				return err;
+			}
+			if (*cx->searching == SEARCH_FORWARD &&
+			    *cx->search_status == SEARCH_WAITING &&
+			    (cx->search_rid > 0 ?
+			    batch[i]->rid == cx->search_rid :
+			    find_commit_match(batch[i], cx->regex,
+			    cx->search_gen, false)))
+				*cx->search_status = SEARCH_CONTINUE;
+		}
+		cx->ncommits_needed = MAX(cx->ncommits_needed - nbuilt, 0);
+	} while (rc == FSL_RC_STEP_ROW && *cx->searching == SEARCH_FORWARD
+	    && *cx->search_status == SEARCH_WAITING && !*cx->quit);
 
 	return rc;
 }
 
 /*
  * Given prepared SQL statement q _XOR_ record ID rid, allocate and build the
- * corresponding commit artifact from the result set. The commit must
- * eventually be disposed of with fnc_commit_artifact_close().
+ * corresponding commit artifact from the result set. If arena is not NULL,
+ * the commit and its strings are allocated from it and are released along
+ * with the arena, else from the heap. Either way, the commit must eventually
+ * be disposed of with fnc_commit_artifact_close(). Given rid, the query is
+ * run on the fcli connection and errors are reported; given q, which timeline
+ * threads step without fnc_mutex, errors are only returned and the caller
+ * must report them.
  */
 static int
-commit_builder(struct fnc_commit_artifact **ptr, fsl_id_t rid, fsl_stmt *q)
+commit_builder(struct fnc_commit_artifact **ptr, fsl_id_t rid, fsl_stmt *q,
+    struct fnc_arena *arena)
 {
-	fsl_cx				*const f = fcli_cx();
-	fsl_db				*db = fsl_needs_repo(f);
+	fsl_cx				*f = NULL;
 	struct fnc_commit_artifact	*commit = NULL;
 	fsl_buffer			 buf = fsl_buffer_empty;
-	const char			*comment, *prefix, *type;
+	const char			*comment, *prefix, *type, *fn = NULL;
 	int				 rc = 0;
 	enum fnc_diff_type		 diff_type = FNC_DIFF_WIKI;
 
 	if (rid) {
+		fsl_db	*db;
+
+		f = fcli_cx();
+		db = fsl_needs_repo(f);
+		/* One row: don't build tmp_tagmap just for its tags. */
 		rc = fsl_db_prepare(db, q, "SELECT "
-		    /* 0 */"uuid, "
-		    /* 1 */"datetime(event.mtime%s), "
-		    /* 2 */"coalesce(euser, user), "
-		    /* 3 */"rid AS rid, "
-		    /* 4 */"event.type AS eventtype, "
-		    /* 5 */"(SELECT group_concat(substr(tagname,5), ',') "
+		    /* 0 */"blob.uuid, "
+		    /* 1 */"coalesce(euser, user), "
+		    /* 2 */"blob.rid AS rid, "
+		    /* 3 */"event.type AS eventtype, "
+		    /* 4 */"(SELECT group_concat(substr(tagname,5), ',') "
 		    "FROM tag, tagxref WHERE tagname GLOB 'sym-*' "
 		    "AND tag.tagid=tagxref.tagid AND tagxref.rid=blob.rid "
-		    "AND tagxref.tagtype > 0) as tags, "
-		    /*6*/"coalesce(ecomment, comment) AS comment "
-		    "FROM event JOIN blob WHERE blob.rid=%d AND event.objid=%d",
-		    fnc_init.utc ? "" : ", 'localtime'", rid, rid);
+		    "AND tagxref.tagtype > 0) AS tags, "
+		    /*5*/"coalesce(ecomment, comment) AS comment, "
+		    /* 6 */"event.mtime AS mtime, "
+		    /* 7 */"pblob.uuid AS puuid, "
+		    /* 8 */"plink.pid AS prid "
+		    "FROM event JOIN blob LEFT JOIN plink "
+		    "ON plink.cid=blob.rid AND plink.isprim "
+		    "LEFT JOIN blob AS pblob ON pblob.rid=plink.pid "
+		    "WHERE blob.rid=%d AND event.objid=%d", rid, rid);
 		if (rc)
 			return RC(FSL_RC_DB, "%s", "fsl_db_prepare");
 		fsl_stmt_step(q);
 	}
 
-	type = fsl_stmt_g_text(q, 4, NULL);
-	comment = fsl_stmt_g_text(q, 6, NULL);
+	type = fsl_stmt_g_text(q, 3, NULL);
+	comment = fsl_stmt_g_text(q, 5, NULL);
 	prefix = NULL;
 
 	switch (*type) {
@@ -2325,44 +3081,376 @@ commit_builder(struct fnc_commit_artifact **ptr, fsl_id_t rid, fsl_stmt *q)
 	case 'f':
 		type = "forum";
 		break;
+	default:
+		type = "unknown";
+		break;
 	};
 	if (!rc && comment)
 		rc = fsl_buffer_append(&buf, comment, -1);
 	if (rc) {
-		rc = RC(rc, "%s", "fsl_buffer_append");
+		fn = "fsl_buffer_append";
 		goto end;
 	}
 
-	commit = calloc(1, sizeof(*commit));
+	if (arena) {
+		commit = fnc_arena_alloc(arena, sizeof(*commit));
+		if (commit)
+			memset(commit, 0, sizeof(*commit));
+	} else
+		commit = calloc(1, sizeof(*commit));
 	if (commit == NULL) {
-		rc = RC(fsl_errno_to_rc(errno, FSL_RC_ERROR), "%s", "calloc");
+		rc = fsl_errno_to_rc(errno, FSL_RC_ERROR);
+		fn = "calloc";
 		goto end;
 	}
+	commit->arena = arena;
 
-	if (!rid && (rc = fsl_stmt_get_id(q, 3, &rid))) {
-		rc = RC(rc, "%s", "fsl_stmt_get_id");
+	if (!rid && (rc = fsl_stmt_get_id(q, 2, &rid))) {
+		fn = "fsl_stmt_get_id";
 		goto end;
 	}
-	/* Is there a more efficient way to get the parent? */
-	commit->puuid = fsl_db_g_text(db, NULL,
-	    "SELECT uuid FROM plink, blob WHERE plink.cid=%d "
-	    "AND blob.rid=plink.pid AND plink.isprim", rid);
-	commit->prid = fsl_uuid_to_rid(f, commit->puuid);
-	commit->uuid = fsl_strdup(fsl_stmt_g_text(q, 0, NULL));
+	/* Primary parent, if any, is joined into the query (see above). */
+	rc = fnc_hash_decode(&commit->uuid, fsl_stmt_g_text(q, 0, NULL));
+	if (!rc)
+		rc = fnc_hash_decode(&commit->puuid,
+		    fsl_stmt_g_text(q, 7, NULL));
+	if (rc) {
+		fnc_commit_artifact_close(commit);
+		fsl_buffer_clear(&buf);
+		fn = "invalid hash";
+		goto end;
+	}
+	commit->prid = commit->puuid.len ? fsl_stmt_g_id(q, 8) : -1;
 	commit->rid = rid;
-	commit->type = fsl_strdup(type);
+	commit->mtime = fsl_stmt_g_double(q, 6);
+	commit->type = type;
 	commit->diff_type = diff_type;
-	commit->timestamp = fsl_strdup(fsl_stmt_g_text(q, 1, NULL));
-	commit->user = fsl_strdup(fsl_stmt_g_text(q, 2, NULL));
-	commit->branch = fsl_strdup(fsl_stmt_g_text(q, 5, NULL));
-	commit->comment = fsl_strdup(comment ? fsl_buffer_str(&buf) : "");
+	commit->user = fnc_arena_intern(arena, fsl_stmt_g_text(q, 1, NULL));
+	commit->branch = fnc_arena_intern(arena, fsl_stmt_g_text(q, 4, NULL));
+	commit->comment = fnc_arena_strdup(arena,
+	    comment ? fsl_buffer_str(&buf) : "");
 	fsl_buffer_clear(&buf);
 
 	*ptr = commit;
 end:
+	if (rc && f != NULL)
+		rc = RC(rc, "%s", fn);
 	return rc;
 }
 
+/*
+ * Create or refresh, in the connection db, the temp table mapping each rid to
+ * the comma-separated list of its branch/tag names as displayed in the
+ * timeline, which replaces a correlated group_concat subquery per timeline
+ * row. The table is built on first use; thereafter, as with tmp_fts, it is
+ * only refreshed if blobs were added since the last refresh, and then only
+ * rids that are among those blobs or have sym-* tagxref rows set by one of
+ * them are recomputed.
+ * Unlike tagxref.mtime, which is the time a tag was made, the blob rid also
+ * catches older tags pulled in by a later sync.
+ */
+static int
+create_tmp_tagmap_table(fsl_db *db)
+{
+	fsl_cx			*const f = fcli_cx();
+	static const char	 tmp_tagmap_table[] =
+	    "CREATE TEMP TABLE IF NOT EXISTS tmp_tagmap("
+	    " rid INTEGER PRIMARY KEY, tags TEXT);"
+	    "CREATE TEMP TABLE IF NOT EXISTS tmp_tagmap_last("
+	    " id INTEGER PRIMARY KEY, tagrid INTEGER);"
+	    "INSERT OR IGNORE INTO tmp_tagmap_last VALUES(1, -1);"
+	    "CREATE TEMP TABLE IF NOT EXISTS tmp_tagmap_dirty("
+	    " rid INTEGER PRIMARY KEY);"
+	    "INSERT OR IGNORE INTO tmp_tagmap_dirty SELECT rid FROM tagxref"
+	    " WHERE (SELECT tagrid FROM tmp_tagmap_last) <"
+	    " (SELECT coalesce(max(rid), 0) FROM blob)"
+	    " AND tagid IN (SELECT tagid FROM tag WHERE tagname GLOB 'sym-*')"
+	    " AND max(rid, srcid, origid) >"
+	    " (SELECT tagrid FROM tmp_tagmap_last);"
+	    "UPDATE tmp_tagmap_last"
+	    " SET tagrid=(SELECT coalesce(max(rid), 0) FROM blob);"
+	    "DELETE FROM tmp_tagmap WHERE rid IN tmp_tagmap_dirty;"
+	    "INSERT INTO tmp_tagmap"
+	    " SELECT tagxref.rid, group_concat(substr(tagname,5), ',')"
+	    " FROM tag, tagxref WHERE tagname GLOB 'sym-*'"
+	    " AND tag.tagid=tagxref.tagid AND tagxref.tagtype > 0"
+	    " AND tagxref.rid IN tmp_tagmap_dirty GROUP BY tagxref.rid;"
+	    "DELETE FROM tmp_tagmap_dirty;";
+	int rc = 0;
+
+	/* Refresh in one transaction so the high-water mark is consistent. */
+	rc = fsl_db_transaction_begin(db);
+	if (!rc)
+		rc = fsl_db_exec_multi(db, tmp_tagmap_table);
+	if (rc) {
+		fsl_db_transaction_end(db, true);
+		return RC(fsl_cx_uplift_db_error2(f, db, rc), "%s",
+		    "fsl_db_exec_multi");
+	}
+	rc = fsl_db_transaction_end(db, false);
+
+	return rc ? RC(fsl_cx_uplift_db_error2(f, db, rc), "%s",
+	    "fsl_db_transaction_end") : rc;
+}
+
+/*
+ * Add to the temp table tmp_fnid, in the connection db, the fnid of path and
+ * of every file beneath it, so the commits of a path-filtered timeline are
+ * found with index seeks on mlink(fnid) rather than a filename subquery per
+ * commit. Rows are keyed by path so that timelines of different paths can
+ * share the table.
+ */
+static int
+create_tmp_fnid_table(fsl_db *db, const char *path)
+{
+	fsl_cx	*const f = fcli_cx();
+	int	 rc;
+
+	if (fsl_cx_is_case_sensitive(f, false))
+		/* Match names beneath path as a range of the name index. */
+		rc = fsl_db_exec_multi(db, "CREATE TEMP TABLE IF NOT EXISTS"
+		    " tmp_fnid(path TEXT, fnid INTEGER,"
+		    " PRIMARY KEY(path, fnid)) WITHOUT ROWID;"
+		    "INSERT OR IGNORE INTO tmp_fnid SELECT %Q, fnid"
+		    " FROM filename WHERE name = %Q"
+		    " OR (name > '%q/' AND name < '%q0')",
+		    path, path, path, path);
+	else
+		rc = fsl_db_exec_multi(db, "CREATE TEMP TABLE IF NOT EXISTS"
+		    " tmp_fnid(path TEXT, fnid INTEGER,"
+		    " PRIMARY KEY(path, fnid)) WITHOUT ROWID;"
+		    "INSERT OR IGNORE INTO tmp_fnid SELECT %Q, fnid"
+		    " FROM filename WHERE name = %Q COLLATE nocase"
+		    " OR lower(name) GLOB lower('%q/*')",
+		    path, path, path);
+
+	return rc ? RC(fsl_cx_uplift_db_error2(f, db, rc), "%s",
+	    "fsl_db_exec_multi") : rc;
+}
+
+/*
+ * Add to the temp table tmp_ancestor, in the connection db, the check-ins
+ * reachable from rid through any of their parents, rid included, or only the
+ * n latest of them if n is positive. The walk follows plink in descending
+ * mtime order, so it ends after n rows rather than visiting all of history.
+ * Rows are keyed by rid, as root, so that timelines opened from different
+ * commits can share the table, and rid's ancestors are only found once.
+ */
+static int
+create_tmp_ancestor_table(fsl_db *db, fsl_id_t rid, int n)
+{
+	fsl_cx	*const f = fcli_cx();
+	int	 rc;
+
+	rc = fsl_db_exec_multi(db, "CREATE TEMP TABLE IF NOT EXISTS"
+	    " tmp_ancestor(root INTEGER, rid INTEGER,"
+	    " PRIMARY KEY(root, rid)) WITHOUT ROWID;"
+	    "WITH RECURSIVE ancestor(rid, mtime) AS ("
+	    " SELECT objid, mtime FROM event WHERE objid=%"FSL_ID_T_PFMT
+	    " AND NOT EXISTS(SELECT 1 FROM tmp_ancestor WHERE root=objid)"
+	    " UNION SELECT plink.pid, event.mtime FROM ancestor, plink, event"
+	    " WHERE plink.cid=ancestor.rid AND event.objid=plink.pid"
+	    " ORDER BY mtime DESC LIMIT %d)"
+	    " INSERT OR IGNORE INTO tmp_ancestor"
+	    " SELECT %"FSL_ID_T_PFMT", rid FROM ancestor",
+	    rid, n > 0 ? n : -1, rid);
+
+	return rc ? RC(fsl_cx_uplift_db_error2(f, db, rc), "%s",
+	    "fsl_db_exec_multi") : rc;
+}
+
+/*
+ * Create or refresh, in the connection db, the tmp_fts full-text index of the
+ * user, comment, and branch of each event as matched by timeline search, then
+ * index up to n more events in rid order, or all of them if n is negative.
+ * Set *done if every event is indexed. Like tmp_tagmap, the index is kept
+ * current incrementally: events whose branch, comment, or user was changed by
+ * a tag artifact newer than the last refresh are reindexed. The trigram
+ * tokenizer can look up any substring of three or more chars; as only the
+ * literals of a regex are looked up and the regex is matched against each
+ * result, the index doesn't keep positions (detail=none), which makes it much
+ * faster to build and a fraction of the size.
+ */
+static int
+create_tmp_fts_table(fsl_db *db, int n, bool *done)
+{
+	fsl_cx			*const f = fcli_cx();
+	static const char	 tmp_fts_table[] =
+	    "CREATE VIRTUAL TABLE IF NOT EXISTS temp.tmp_fts USING fts5("
+	    " user, comment, branch, tokenize='trigram', detail='none',"
+	    " columnsize=0);"
+	    "CREATE TEMP TABLE IF NOT EXISTS tmp_fts_last("
+	    " id INTEGER PRIMARY KEY, rid INTEGER, next INTEGER,"
+	    " tagrid INTEGER);"
+	    "INSERT OR IGNORE INTO tmp_fts_last"
+	    " SELECT 1, 0, 0, coalesce(max(rid), 0) FROM blob;"
+	    "CREATE TEMP TABLE IF NOT EXISTS tmp_fts_dirty("
+	    " rid INTEGER PRIMARY KEY);"
+	    /* Comments as displayed; see commit_builder(). */
+	    "CREATE TEMP VIEW IF NOT EXISTS tmp_fts_src AS"
+	    " SELECT objid, u, CASE WHEN type <> 'w' THEN c"
+	    " WHEN c GLOB '+*' THEN 'Added: ' || substr(c, 2)"
+	    " WHEN c GLOB '-*' THEN 'Deleted: ' || substr(c, 2)"
+	    " WHEN c GLOB ':*' THEN 'Edited: ' || substr(c, 2)"
+	    " ELSE c END, tmp_tagmap.tags"
+	    " FROM (SELECT objid, type, coalesce(euser, user) AS u,"
+	    " coalesce(ecomment, comment) AS c FROM event)"
+	    " LEFT JOIN tmp_tagmap ON tmp_tagmap.rid=objid;"
+	    "INSERT OR IGNORE INTO tmp_fts_dirty SELECT rid FROM tagxref"
+	    " WHERE (SELECT tagrid FROM tmp_fts_last) <"
+	    " (SELECT max(rid) FROM blob)"
+	    " AND tagid IN (SELECT tagid FROM tag WHERE tagname GLOB 'sym-*'"
+	    " OR tagname IN ('comment', 'user'))"
+	    " AND max(srcid, origid) > (SELECT tagrid FROM tmp_fts_last)"
+	    " AND rid <= (SELECT rid FROM tmp_fts_last);"
+	    "UPDATE tmp_fts_last SET next=coalesce((SELECT max(objid) FROM"
+	    " (SELECT objid FROM event WHERE objid > tmp_fts_last.rid"
+	    " ORDER BY objid LIMIT %d)), rid),"
+	    " tagrid=(SELECT coalesce(max(rid), 0) FROM blob);"
+	    "DELETE FROM tmp_fts WHERE rowid IN tmp_fts_dirty;"
+	    "INSERT INTO tmp_fts(rowid, user, comment, branch)"
+	    " SELECT * FROM tmp_fts_src WHERE objid IN tmp_fts_dirty"
+	    " OR objid BETWEEN (SELECT rid + 1 FROM tmp_fts_last)"
+	    " AND (SELECT next FROM tmp_fts_last);"
+	    "UPDATE tmp_fts_last SET rid=next;"
+	    "DELETE FROM tmp_fts_dirty;";
+	int rc = 0;
+
+	rc = create_tmp_tagmap_table(db);
+	if (rc)
+		return rc;
+
+	rc = fsl_db_transaction_begin(db);
+	if (!rc)
+		rc = fsl_db_exec_multi(db, tmp_fts_table, n);
+	if (rc) {
+		fsl_db_transaction_end(db, true);
+		return RC(fsl_cx_uplift_db_error2(f, db, rc), "%s",
+		    "fsl_db_exec_multi");
+	}
+	*done = !fsl_db_exists(db, "SELECT 1 FROM event"
+	    " WHERE objid > (SELECT rid FROM tmp_fts_last)");
+	rc = fsl_db_transaction_end(db, false);
+
+	return rc ? RC(fsl_cx_uplift_db_error2(f, db, rc), "%s",
+	    "fsl_db_transaction_end") : rc;
+}
+
+/*
+ * Open a read-only connection to the repository db for the timeline thread
+ * and build its tmp_tagmap table. The connection isn't bound to the fsl_cx,
+ * so it can be stepped without fnc_mutex while the main thread queries the
+ * fsl_cx connection. If the repository is in WAL mode, it reads a snapshot
+ * that doesn't block writers. On success, *ptr must be disposed of with
+ * fsl_db_close(); on error, *ptr is NULL.
+ */
+static int
+tl_open_db(fsl_db **ptr)
+{
+	fsl_cx		*const f = fcli_cx();
+	fsl_db		*db;
+	const char	*repo;
+	int		 rc;
+
+	*ptr = NULL;
+	repo = fsl_cx_db_file_repo(f, NULL);
+	if (repo == NULL)
+		return RC(FSL_RC_NOT_A_REPO, "%s", "fsl_cx_db_file_repo");
+
+	db = fsl_db_malloc();
+	if (db == NULL)
+		return RC(FSL_RC_OOM, "%s", "fsl_db_malloc");
+	rc = fsl_db_open(db, repo, FSL_OPEN_F_RO);
+	if (!rc)
+		rc = fsl_db_exec(db, "PRAGMA busy_timeout=5000");
+	if (rc) {
+		rc = RC(fsl_cx_uplift_db_error2(f, db, rc), "%s",
+		    "fsl_db_open");
+		fsl_db_close(db);
+		return rc;
+	}
+
+	rc = create_tmp_tagmap_table(db);
+	if (rc) {
+		fsl_db_close(db);
+		return rc;
+	}
+
+	*ptr = db;
+	return FSL_RC_OK;
+}
+
+/*
+ * Open a new fsl_cx on the repository of fcli_cx() for use by a background
+ * thread. As the fsl_cx API is not thread-safe, a worker must not share
+ * fcli_cx() with the main thread; the clone has its own repository db
+ * connection and blob cache, so fsl_content_get(), fsl_deck_load_rid(),
+ * fsl_annotate(), etc. can run on it concurrently with the main thread.
+ * libfossil can't open a repository read-only, so writes to anything but
+ * temp tables, which the likes of fsl_annotate() need, are denied with
+ * fnc_cx_clone_auth(). Must be called from the main thread. On success, *ptr
+ * must be disposed of with fsl_cx_finalize(); on error, *ptr is NULL.
+ */
+static int
+fnc_cx_clone(fsl_cx **ptr)
+{
+	fsl_cx		*const f = fcli_cx();
+	fsl_cx		*clone = NULL;
+	const char	*repo;
+	int		 rc;
+
+	*ptr = NULL;
+	repo = fsl_cx_db_file_repo(f, NULL);
+	if (repo == NULL)
+		return RC(FSL_RC_NOT_A_REPO, "%s", "fsl_cx_db_file_repo");
+
+	rc = fsl_cx_init(&clone, NULL);
+	if (rc) {
+		fsl_cx_finalize(clone);
+		return RC(rc, "%s", "fsl_cx_init");
+	}
+	rc = fsl_repo_open(clone, repo);
+	if (!rc && sqlite3_set_authorizer(fsl_cx_db_repo(clone)->dbh,
+	    fnc_cx_clone_auth, NULL) != SQLITE_OK)
+		rc = fsl_cx_err_set(clone, FSL_RC_DB, "%s",
+		    "sqlite3_set_authorizer");
+	if (rc) {
+		rc = RC(rc, "%s: %b", repo, &fsl_cx_err_get_e(clone)->msg);
+		fsl_cx_finalize(clone);
+		return rc;
+	}
+
+	*ptr = clone;
+	return FSL_RC_OK;
+}
+
+static int
+fnc_cx_clone_auth(void *state, int action, const char *arg1,
+    const char *arg2, const char *dbname, const char *trigger)
+{
+	switch (action) {
+	case SQLITE_INSERT:
+	case SQLITE_UPDATE:
+	case SQLITE_DELETE:
+		return dbname && fsl_strcmp(dbname, "temp") ?
+		    SQLITE_DENY : SQLITE_OK;
+	case SQLITE_ALTER_TABLE:
+	case SQLITE_CREATE_INDEX:
+	case SQLITE_CREATE_TABLE:
+	case SQLITE_CREATE_TRIGGER:
+	case SQLITE_CREATE_VIEW:
+	case SQLITE_CREATE_VTABLE:
+	case SQLITE_DROP_INDEX:
+	case SQLITE_DROP_TABLE:
+	case SQLITE_DROP_TRIGGER:
+	case SQLITE_DROP_VIEW:
+	case SQLITE_DROP_VTABLE:
+		return SQLITE_DENY;
+	default:
+		return SQLITE_OK;
+	}
+}
+
 static int
 signal_tl_thread(struct fnc_view *view, int wait)
 {
@@ -2373,9 +3461,6 @@ signal_tl_thread(struct fnc_view *view, int wait)
 		if (cx->eotl)
 			break;
 
-		if (view->mode == VIEW_SPLIT_HRZN)
-			cx->reset = true;
-
 		/* Wake timeline thread. */
 		if ((rc = pthread_cond_signal(&cx->commit_consumer)))
 			return RC(fsl_errno_to_rc(rc, FSL_RC_MISUSE),
@@ -2417,7 +3502,7 @@ draw_commits(struct fnc_view *view)
 	const char			*search_str = NULL;
 	char				*headln = NULL, *idxstr = NULL;
 	char				*branch = NULL, *type = NULL;
-	char				*uuid = NULL;
+	char				*uuid = NULL, hex[FNC_HASH_HEXSZ];
 	wchar_t				*wcstr;
 	attr_t				 rx = A_BOLD;
 	int				 ncommits = 0, rc = 0, wstrlen = 0;
@@ -2425,7 +3510,7 @@ draw_commits(struct fnc_view *view)
 
 	if (s->selected_commit && !(view->searching != SEARCH_DONE &&
 	    view->search_status == SEARCH_WAITING)) {
-		uuid = fsl_strdup(s->selected_commit->commit->uuid);
+		uuid = fnc_hash_hex(&s->selected_commit->commit->uuid, hex);
 		branch = fsl_strdup(s->selected_commit->commit->branch);
 		type = fsl_strdup(s->selected_commit->commit->type);
 	}
@@ -2535,7 +3620,7 @@ draw_commits(struct fnc_view *view)
 		fsl_free(usr_wcstr);
 		fsl_free(user);
 		++ncommits;
-		entry = TAILQ_NEXT(entry, entries);
+		entry = commit_queue_next(&s->commits, entry);
 	}
 
 	ncommits = 0;
@@ -2551,14 +3636,13 @@ draw_commits(struct fnc_view *view)
 			wattr_off(view->window, A_REVERSE, NULL);
 		++ncommits;
 		s->last_commit_onscreen = entry;
-		entry = TAILQ_NEXT(entry, entries);
+		entry = commit_queue_next(&s->commits, entry);
 	}
 	drawborder(view);
 
 end:
 	free(branch);
 	free(type);
-	free(uuid);
 	free(idxstr);
 	free(headln);
 	return rc;
@@ -2745,22 +3829,19 @@ write_commit_line(struct fnc_view *view, struct fnc_commit_artifact *commit,
 	struct fnc_colour		*c = NULL;
 	wchar_t				*usr_wcstr = NULL, *wcomment = NULL;
 	char				*comment0 = NULL, *comment = NULL;
-	char				*date = NULL;
+	const char			*date;
 	char				*eol = NULL, *pad = NULL, *user = NULL;
-	size_t				 i = 0;
+	char				 hex[11];	/* 5-byte prefix. */
 	int				 col_pos, ncols_avail, usrlen;
 	int				 commentlen, rc = 0;
 
-	/* Trim time component from timestamp for the date field. */
-	date = fsl_strdup(commit->timestamp);
-	while (!fsl_isspace(date[i++])) {}
-	date[i] = '\0';
+	date = fnc_date_cache_get(&s->dates, commit->mtime);
 	col_pos = MIN(view->ncols, ISO8601_DATE_ONLY + 1);
 	if (s->colour)
 		c = get_colour(&s->colours, FNC_COLOUR_DATE);
 	if (c)
 		wattr_on(view->window, COLOR_PAIR(c->scheme), NULL);
-	waddnstr(view->window, date, col_pos);
+	waddnstr(view->window, date ? date : "---------- ", col_pos);
 	if (c)
 		wattr_off(view->window, COLOR_PAIR(c->scheme), NULL);
 	if (col_pos > view->ncols)
@@ -2772,7 +3853,9 @@ write_commit_line(struct fnc_view *view, struct fnc_commit_artifact *commit,
 			c = get_colour(&s->colours, FNC_COLOUR_COMMIT);
 		if (c)
 			wattr_on(view->window, COLOR_PAIR(c->scheme), NULL);
-		wprintw(view->window, "%.9s ", commit->uuid);
+		/* Only encode as much of the hash as is shown. */
+		fsl_encode16(commit->uuid.d, (unsigned char *)hex, 5);
+		wprintw(view->window, "%.9s ", hex);
 		if (c)
 			wattr_off(view->window, COLOR_PAIR(c->scheme), NULL);
 		col_pos += 10;
@@ -2829,7 +3912,6 @@ write_commit_line(struct fnc_view *view, struct fnc_commit_artifact *commit,
 		++col_pos;
 	}
 end:
-	fsl_free(date);
 	fsl_free(user);
 	fsl_free(usr_wcstr);
 	fsl_free(pad);
@@ -2838,6 +3920,87 @@ end:
 	return rc;
 }
 
+/*
+ * Convert julian day mtime to a time_t, and fill tm with its UTC or local
+ * time per the --utc option. Like SQLite's datetime(), mtime is rounded to
+ * the millisecond then truncated to the second. Return -1 on error.
+ */
+static time_t
+fnc_mtime_to_tm(double mtime, struct tm *tm)
+{
+	time_t	t;
+
+	/* 210866760000 is the unix epoch in julian seconds. */
+	t = (time_t)((int64_t)(mtime * 86400000.0 + 0.5) / 1000 -
+	    210866760000LL);
+	if ((fnc_init.utc ? gmtime_r(&t, tm) : localtime_r(&t, tm)) == NULL)
+		return -1;
+
+	return t;
+}
+
+/*
+ * Format mtime as "YYYY-MM-DD HH:MM:SS" into buf, which should be at least
+ * ISO8601_TIMESTAMP bytes. Return buf, or NULL on error.
+ */
+static char *
+fnc_mtime_to_str(double mtime, char *buf, size_t sz)
+{
+	struct tm	tm;
+
+	if (fnc_mtime_to_tm(mtime, &tm) == -1 ||
+	    !strftime(buf, sz, "%Y-%m-%d %H:%M:%S", &tm))
+		return NULL;
+
+	return buf;
+}
+
+/*
+ * Return the "YYYY-MM-DD " date field of a timeline line for mtime from the
+ * cache, formatting it into the least recently filled slot on a miss. Return
+ * NULL on error.
+ */
+static const char *
+fnc_date_cache_get(struct fnc_date_cache *dc, double mtime)
+{
+	struct tm	tm;
+	time_t		t;
+	int		i;
+
+	if ((t = fnc_mtime_to_tm(mtime, &tm)) == -1)
+		return NULL;
+
+	for (i = 0; i < dc->nslots; ++i)
+		if (t >= dc->slot[i].start && t < dc->slot[i].end)
+			return dc->slot[i].date;
+
+	i = dc->next;
+	dc->next = (dc->next + 1) % FNC_DATE_CACHE_SZ;
+	if (dc->nslots < FNC_DATE_CACHE_SZ)
+		++dc->nslots;
+	if (!strftime(dc->slot[i].date, sizeof(dc->slot[i].date),
+	    "%Y-%m-%d ", &tm)) {
+		dc->slot[i].start = dc->slot[i].end = 0;
+		return NULL;
+	}
+
+	/* Local days aren't always 24h long, so let mktime() find the span. */
+	if (fnc_init.utc) {
+		dc->slot[i].start = t - (tm.tm_hour * 3600 + tm.tm_min * 60 +
+		    tm.tm_sec);
+		dc->slot[i].end = dc->slot[i].start + 86400;
+	} else {
+		tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+		tm.tm_isdst = -1;
+		dc->slot[i].start = mktime(&tm);
+		++tm.tm_mday;
+		tm.tm_isdst = -1;
+		dc->slot[i].end = mktime(&tm);
+	}
+
+	return dc->slot[i].date;
+}
+
 static int
 view_input(struct fnc_view **new, int *done, struct fnc_view *view,
     struct view_tailhead *views)
@@ -3048,6 +4211,8 @@ help(struct fnc_view *view)
 	    {"  b                ", "  ❬b❭             "},
 	    {"  F                ", "  ❬F❭             "},
 	    {"  t                ", "  ❬t❭             "},
+	    {"  @                ", "  ❬@❭             "},
+	    {"  #                ", "  ❬#❭             "},
 	    {""},
 	    {""}, /* Diff */
 	    {"  Space            ", "  ❬Space❭         "},
@@ -3134,6 +4299,8 @@ help(struct fnc_view *view)
 	    "Open and populate branch view with all repository branches",
 	    "Open prompt to enter term with which to filter new timeline view",
 	    "Display a tree reflecting the state of the selected commit",
+	    "Open prompt to enter date and jump to the commit on or before it",
+	    "Open prompt to enter hash or symbol and jump to the commit",
 	    "",
 	    "Diff",
 	    "Scroll down one page of diff output",
@@ -3379,8 +4546,7 @@ tl_input_handler(struct fnc_view **new_view, struct fnc_view *view, int ch)
 	}
 	case KEY_END:
 	case 'G':
-		view->search_status = SEARCH_FOR_END;
-		view_search_start(view);
+		rc = tl_goto_end(view);
 		break;
 	case 'k':
 	case KEY_UP:
@@ -3441,6 +4607,12 @@ tl_input_handler(struct fnc_view **new_view, struct fnc_view *view, int ch)
 		}
 		break;
 	}
+	case '@':
+		rc = tl_goto_date(view);
+		break;
+	case '#':
+		rc = tl_goto_symbol(view);
+		break;
 	case 't':
 		if (s->selected_commit == NULL)
 			break;
@@ -3523,8 +4695,7 @@ move_tl_cursor_up(struct fnc_view *view, uint16_t page, bool home)
 	if (s->first_commit_onscreen == NULL)
 		return;
 
-	if ((page && TAILQ_FIRST(&s->commits.head) == s->first_commit_onscreen)
-	    || home)
+	if ((page && s->first_commit_onscreen->idx == 0) || home)
 		s->selected_idx = home ? 0 : MAX(0, s->selected_idx - page - 1);
 
 	if (!page && !home && s->selected_idx > 0)
@@ -3592,6 +4763,8 @@ init_view(struct fnc_view **new_view, struct fnc_view *view,
 			break;
 		rc = init_diff_view(new_view, x, y, s->selected_commit->commit,
 		    view);
+		if (!rc)
+			s->diff_idx = s->selected_commit->idx;
 		break;
 	}
 	case FNC_VIEW_BLAME: {
@@ -3746,14 +4919,16 @@ timeline_scroll_down(struct fnc_view *view, int maxscroll)
 	}
 
 	do {
-		pentry = TAILQ_NEXT(s->last_commit_onscreen, entries);
+		pentry = commit_queue_next(&s->commits,
+		    s->last_commit_onscreen);
 		if (pentry == NULL && view->mode != VIEW_SPLIT_HRZN)
 			break;
 
 		s->last_commit_onscreen = pentry ?
 		    pentry : s->last_commit_onscreen;
 
-		pentry = TAILQ_NEXT(s->first_commit_onscreen, entries);
+		pentry = commit_queue_next(&s->commits,
+		    s->first_commit_onscreen);
 		if (pentry == NULL)
 			break;
 		s->first_commit_onscreen = pentry;
@@ -3767,37 +4942,256 @@ static void
 timeline_scroll_up(struct fnc_tl_view_state *s, int maxscroll)
 {
 	struct commit_entry	*entry;
-	int			 nscrolled = 0;
 
-	entry = TAILQ_FIRST(&s->commits.head);
-	if (s->first_commit_onscreen == entry)
+	if (s->first_commit_onscreen->idx == 0)
 		return;
 
-	entry = s->first_commit_onscreen;
-	while (entry && nscrolled < maxscroll) {
-		entry = TAILQ_PREV(entry, commit_tailhead, entries);
-		if (entry) {
-			s->first_commit_onscreen = entry;
-			++nscrolled;
-		}
-	}
+	entry = commit_queue_get(&s->commits,
+	    MAX(s->first_commit_onscreen->idx - maxscroll, 0));
+	if (entry)
+		s->first_commit_onscreen = entry;
+}
+
+/*
+ * Select entry, scrolling the timeline as if the cursor had been moved to it
+ * one line at a time: an entry below the page ends up on the last line, and
+ * an entry above the page on the first line.
+ */
+static void
+select_commit_entry(struct fnc_view *view, struct commit_entry *entry)
+{
+	struct fnc_tl_view_state	*s = &view->state.timeline;
+	int				 maxidx = MAX(view->nlines - 2, 0);
+
+	if (s->first_commit_onscreen == NULL || entry == NULL)
+		return;
+
+	if (entry->idx < s->first_commit_onscreen->idx) {
+		s->first_commit_onscreen = entry;
+		s->selected_idx = 0;
+	} else if (entry->idx > s->first_commit_onscreen->idx + maxidx) {
+		s->first_commit_onscreen = commit_queue_get(&s->commits,
+		    entry->idx - maxidx);
+		s->selected_idx = maxidx;
+	} else
+		s->selected_idx = entry->idx - s->first_commit_onscreen->idx;
+
+	s->last_commit_onscreen = commit_queue_get(&s->commits,
+	    MIN(s->first_commit_onscreen->idx + maxidx,
+	    s->commits.ncommits - 1));
+	s->selected_commit = entry;
 }
 
 static void
 select_commit(struct fnc_tl_view_state *s)
 {
 	struct commit_entry	*entry;
-	int			 ncommits = 0;
 
-	entry = s->first_commit_onscreen;
-	while (entry) {
-		if (ncommits == s->selected_idx) {
-			s->selected_commit = entry;
-			break;
+	if (s->first_commit_onscreen == NULL)
+		return;
+
+	entry = commit_queue_get(&s->commits,
+	    s->first_commit_onscreen->idx + s->selected_idx);
+	if (entry)
+		s->selected_commit = entry;
+}
+
+/*
+ * Prompt for a date and select the latest commit on or before it.
+ */
+static int
+tl_goto_date(struct fnc_view *view)
+{
+	struct fnc_tl_view_state	*s = &view->state.timeline;
+	struct input			 input = {NULL, "date: ", INPUT_ALPHA,
+					     true};
+	struct commit_key		 key;
+	int				 rc;
+
+	rc = fnc_prompt_input(view, &input);
+	if (rc || !input.buf[0])
+		return rc;
+
+	rc = fnc_date_to_mtime(&key.mtime, input.buf, 1);
+	if (rc) {
+		fnc_print_msg(view, rc == FSL_RC_AMBIGUOUS ?
+		    "-- ambiguous date --" : "-- invalid date --",
+		    true, true, true);
+		fcli_err_reset();
+		return FSL_RC_OK;
+	}
+
+	/* With rid 0, the key is after every commit on the date. */
+	key.rid = 0;
+	rc = commit_queue_prepare(&s->commits, false);
+	if (!rc)
+		rc = commit_queue_skip(&s->commits, &key, &key, 0);
+	if (rc == FSL_RC_STEP_DONE) {
+		fnc_print_msg(view, "-- no commits on or before date --",
+		    true, true, true);
+		return FSL_RC_OK;
+	}
+	if (rc)
+		return rc;
+
+	return tl_goto_commit(view, &key, false);
+}
+
+/*
+ * Prompt for a hash prefix or symbolic name (e.g., branch or tag) and select
+ * the commit it resolves to in the middle of the view.
+ */
+static int
+tl_goto_symbol(struct fnc_view *view)
+{
+	struct fnc_tl_view_state	*s = &view->state.timeline;
+	struct input			 input = {NULL, "hash or symbol: ",
+					     INPUT_ALPHA, true};
+	struct commit_key		 key, found;
+	int				 rc;
+
+	rc = fnc_prompt_input(view, &input);
+	if (rc || !input.buf[0])
+		return rc;
+
+	rc = fsl_sym_to_rid(fcli_cx(), input.buf, FSL_SATYPE_ANY, &key.rid);
+	if (rc) {
+		fnc_print_msg(view, rc == FSL_RC_AMBIGUOUS ?
+		    "-- ambiguous hash prefix --" : "-- symbol not found --",
+		    true, true, true);
+		fcli_err_reset();
+		return FSL_RC_OK;
+	}
+
+	key.mtime = fsl_db_g_double(fsl_cx_db_repo(fcli_cx()), -1.0,
+	    "SELECT mtime FROM event WHERE objid=%d", key.rid);
+	rc = commit_queue_prepare(&s->commits, false);
+	if (rc)
+		return rc;
+
+	/* The first commit from key on is key if it's on the timeline. */
+	found.rid = 0;
+	if (key.mtime >= 0)
+		rc = commit_queue_skip(&s->commits, &found, &key, 0);
+	if (rc && rc != FSL_RC_STEP_DONE)
+		return rc;
+	if (found.rid != key.rid) {
+		fnc_print_msg(view, "-- commit not on timeline --",
+		    true, true, true);
+		return FSL_RC_OK;
+	}
+
+	return tl_goto_commit(view, &key, true);
+}
+
+/*
+ * Select the last commit on the timeline: the oldest, found by stepping the
+ * event index in ascending order, or the one at the record limit. Only the
+ * chunks holding it and the page before it are loaded; the commits between
+ * them and those loaded are skipped over like those before a date.
+ */
+static int
+tl_goto_end(struct fnc_view *view)
+{
+	struct commit_queue	*commits = &view->state.timeline.commits;
+	struct commit_key	 key;
+	int			 limit = fnc_init.nrecords.limit, rc;
+
+	if (commits->ncommits == 0)
+		return FSL_RC_OK;
+	if ((rc = commit_queue_prepare(commits, false)))
+		return rc;
+
+	rc = FSL_RC_STEP_DONE;
+	if (limit > 0)
+		rc = commit_queue_skip(commits, &key, &commits->keys[0],
+		    limit - 1);
+	if (rc == FSL_RC_STEP_DONE) {
+		key.mtime = -DBL_MAX;
+		key.rid = 0;
+		rc = commit_queue_skip(commits, &key, &key, -1);
+	}
+	if (rc == FSL_RC_STEP_DONE)
+		rc = RC(FSL_RC_NOT_FOUND, "%s",
+		    "timeline changed since loaded");
+	if (rc)
+		return rc;
+
+	return tl_goto_commit(view, &key, false);
+}
+
+/*
+ * Select the commit at key, which must be on the timeline, at the top of the
+ * view or, if center is true, in the middle of it. Its index is found by
+ * counting the commits before it in the event index. If that's past the
+ * commits loaded, rather than load every one up to it, have the timeline
+ * thread skip to the chunk it's in; see tl_seek_commits(). Commits before it
+ * in chunks skipped over are keyed backward from it as they're scrolled to.
+ * Caller must hold fnc_mutex.
+ */
+static int
+tl_goto_commit(struct fnc_view *view, const struct commit_key *key,
+    bool center)
+{
+	struct fnc_tl_view_state	*s = &view->state.timeline;
+	struct fnc_tl_thread_cx		*cx = &s->thread_cx;
+	struct commit_queue		*commits = &s->commits;
+	struct commit_entry		*entry;
+	int				 idx, first, n, rc;
+
+	if ((rc = commit_queue_prepare(commits, false)))
+		return rc;
+
+	rc = fsl_stmt_bind_double(commits->rank, 1, key->mtime);
+	if (!rc)
+		rc = fsl_stmt_bind_id(commits->rank, 2, key->rid);
+	if (!rc && (rc = fsl_stmt_step(commits->rank)) == FSL_RC_STEP_ROW)
+		rc = FSL_RC_OK;
+	idx = rc ? 0 : fsl_stmt_g_int32(commits->rank, 0);
+	fsl_stmt_reset(commits->rank);
+	if (rc)
+		return RC(rc, "%s", "fsl_stmt_step");
+
+	if (fnc_init.nrecords.limit > 0 && idx >= fnc_init.nrecords.limit) {
+		fnc_print_msg(view, "-- commit is past the record limit --",
+		    true, true, true);
+		return FSL_RC_OK;
+	}
+
+	n = MAX(view->nlines - 1, 1);
+	if (idx >= commits->ncommits && !cx->eotl) {
+		first = idx & ~COMMIT_CHUNK_MASK;
+		if (first > commits->ncommits) {
+			rc = commit_queue_skip(commits, &cx->seek_key, key,
+			    first - idx);
+			if (rc == FSL_RC_STEP_DONE)
+				rc = RC(FSL_RC_NOT_FOUND, "%s",
+				    "timeline changed since loaded");
+			if (rc)
+				return rc;
+			cx->seek_idx = idx;
 		}
-		entry = TAILQ_NEXT(entry, entries);
-		++ncommits;
+		cx->ncommits_needed = MAX(cx->ncommits_needed,
+		    idx + n - commits->ncommits);
+		rc = signal_tl_thread(view, 1);
+		cx->seek_idx = -1;
+		if (rc)
+			return rc;
 	}
+
+	/* If the commit is among the last, fill the page before it. */
+	first = center ? MAX(idx - (view->nlines - 2) / 2, 0) : idx;
+	if (cx->eotl)
+		first = MAX(MIN(first, commits->ncommits - n), 0);
+	entry = commit_queue_get(commits, idx);
+	if (entry)
+		s->first_commit_onscreen = commit_queue_get(commits, first);
+	if (entry == NULL || s->first_commit_onscreen == NULL)
+		return RC(FSL_RC_NOT_FOUND, "%s",
+		    "timeline changed since loaded");
+	select_commit_entry(view, entry);
+
+	return FSL_RC_OK;
 }
 
 static int
@@ -3910,22 +5304,17 @@ view_search_start(struct fnc_view *view)
 	if (view->nlines < 1)
 		return rc;
 
-	if (view->search_status == SEARCH_FOR_END) {
-		view->grep_init(view);
-		view->started_search = true;
-		view->searching = SEARCH_FORWARD;
-		view->search_status = SEARCH_WAITING;
-		view->state.timeline.thread_cx.endjmp = true;
-		rc = view->grep(view);
-
-		return rc;
-	}
-
 	rc = fnc_prompt_input(view, &input);
 	if (rc)
 		return rc;
 
 	if (regcomp(&view->regex, input.buf, REG_EXTENDED | REG_NEWLINE) == 0) {
+		if (view->vid == FNC_VIEW_TIMELINE) {
+			rc = tl_search_terms(&view->state.timeline.thread_cx,
+			    input.buf);
+			if (rc)
+				return rc;
+		}
 		view->grep_init(view);
 		view->started_search = true;
 		view->searching = SEARCH_FORWARD;
@@ -3943,17 +5332,20 @@ tl_grep_init(struct fnc_view *view)
 
 	s->matched_commit = NULL;
 	s->search_commit = NULL;
+	s->thread_cx.search_rid = 0;
+	s->thread_cx.search_fts = false;
+	++s->thread_cx.search_gen;
 }
 
 static int
 tl_search_next(struct fnc_view *view)
 {
 	struct fnc_tl_view_state	*s = &view->state.timeline;
-	struct commit_entry		*entry;
+	struct commit_entry		*entry, *last;
 	int				 rc = 0;
 
 	if (!s->thread_cx.ncommits_needed && view->started_search)
-		halfdelay(1);
+		start_polling(&s->polling);
 
 	/* Show status update in timeline view. */
 	show_timeline_view(view);
@@ -3971,43 +5363,81 @@ tl_search_next(struct fnc_view *view)
 			    "%s", "pthread_mutex_lock");
 		if (ch == KEY_BACKSPACE) {
 			view->search_status = SEARCH_CONTINUE;
+			s->thread_cx.search_rid = 0;
+			s->thread_cx.search_fts = false;
+			stop_polling(&s->polling);
 			return rc;
 		}
 		if (view->searching == SEARCH_FORWARD)
-			entry = TAILQ_NEXT(s->search_commit, entries);
+			entry = commit_queue_next(&s->commits,
+			    s->search_commit);
 		else
-			entry = TAILQ_PREV(s->search_commit, commit_tailhead,
-			    entries);
+			entry = commit_queue_prev(&s->commits,
+			    s->search_commit);
 	} else if (s->matched_commit) {
 		if (view->searching == SEARCH_FORWARD)
-			entry = TAILQ_NEXT(s->matched_commit, entries);
+			entry = commit_queue_next(&s->commits,
+			    s->matched_commit);
 		else
-			entry = TAILQ_PREV(s->matched_commit, commit_tailhead,
-			    entries);
+			entry = commit_queue_prev(&s->commits,
+			    s->matched_commit);
 	} else {
 		if (view->searching == SEARCH_FORWARD)
-			entry = TAILQ_FIRST(&s->commits.head);
+			entry = commit_queue_get(&s->commits, 0);
 		else
-			entry = TAILQ_LAST(&s->commits.head, commit_tailhead);
+			entry = commit_queue_get(&s->commits,
+			    s->commits.ncommits - 1);
+	}
+
+	/* Test a long run of loaded commits in parallel, then walk on. */
+	if (entry && !s->thread_cx.search_rid) {
+		struct tl_scan	sc;
+
+		sc.start = entry->idx;
+		sc.dir = view->searching == SEARCH_FORWARD ? 1 : -1;
+		if ((rc = tl_scan_commits(view, &sc)))
+			return rc;
+		if (sc.cancel) {
+			view->search_status = SEARCH_CONTINUE;
+			s->thread_cx.search_fts = false;
+			stop_polling(&s->polling);
+			return rc;
+		}
+		if (sc.match >= 0)
+			entry = commit_queue_get(&s->commits, sc.match);
+		else if (sc.end != sc.start - sc.dir) {
+			s->search_commit = commit_queue_get(&s->commits,
+			    sc.end);
+			entry = commit_queue_get(&s->commits,
+			    sc.end + sc.dir);
+		}
 	}
 
 	while (1) {
 		if (entry == NULL) {
-			if (s->thread_cx.eotl && s->thread_cx.endjmp) {
-				s->matched_commit = TAILQ_LAST(&s->commits.head,
-				    commit_tailhead);
-				view->search_status = SEARCH_COMPLETE;
-				s->thread_cx.endjmp = false;
-				break;
-			}
-			if (s->thread_cx.eotl ||
+			if (s->thread_cx.eotl || s->thread_cx.search_rid < 0 ||
 			    view->searching == SEARCH_REVERSE) {
 				view->search_status = (s->matched_commit ==
 				    NULL ?  SEARCH_NO_MATCH : SEARCH_COMPLETE);
 				s->search_commit = NULL;
-				cbreak();
+				s->thread_cx.search_rid = 0;
+				stop_polling(&s->polling);
 				return rc;
 			}
+			/*
+			 * Rather than have every commit loaded and matched in
+			 * turn, have the timeline thread look up the next
+			 * match, if any, in tmp_fts then load commits up to it.
+			 */
+			if (!s->thread_cx.search_rid &&
+			    !s->thread_cx.search_fts && !s->thread_cx.nofts &&
+			    s->thread_cx.fts_match && s->thread_cx.fts_sql &&
+			    (last = commit_queue_get(&s->commits,
+			    s->commits.ncommits - 1))) {
+				s->thread_cx.search_key.mtime = last->mtime;
+				s->thread_cx.search_key.rid = last->rid;
+				s->thread_cx.search_fts = true;
+			}
 			/*
 			 * Wake the timeline thread to produce more commits.
 			 * Search will resume at s->search_commit upon return.
@@ -4016,56 +5446,574 @@ tl_search_next(struct fnc_view *view)
 			return signal_tl_thread(view, 0);
 		}
 
-		if (!s->thread_cx.endjmp && find_commit_match(entry->commit,
-		    &view->regex)) {
+		if (s->thread_cx.search_rid ?
+		    entry->commit->rid == s->thread_cx.search_rid :
+		    find_commit_match(entry->commit, &view->regex,
+		    s->thread_cx.search_gen, false)) {
 			view->search_status = SEARCH_CONTINUE;
 			s->matched_commit = entry;
+			s->thread_cx.search_rid = 0;
 			break;
 		}
 
 		s->search_commit = entry;
+		/* Don't let a long search load the whole timeline. */
+		if ((entry->idx & COMMIT_CHUNK_MASK) == 0 ||
+		    (entry->idx & COMMIT_CHUNK_MASK) == COMMIT_CHUNK_MASK)
+			tl_trim_commits(s);
 		if (view->searching == SEARCH_FORWARD)
-			entry = TAILQ_NEXT(entry, entries);
+			entry = commit_queue_next(&s->commits, entry);
 		else
-			entry = TAILQ_PREV(entry, commit_tailhead, entries);
+			entry = commit_queue_prev(&s->commits, entry);
 	}
 
-	if (s->matched_commit) {
-		int cur = s->selected_commit->idx;
-		while (cur < s->matched_commit->idx) {
-			if ((rc = tl_input_handler(NULL, view, KEY_DOWN)))
-				return rc;
-			++cur;
-		}
-		while (cur > s->matched_commit->idx) {
-			if ((rc = tl_input_handler(NULL, view, KEY_UP)))
-				return rc;
-			--cur;
+	if (s->matched_commit)
+		select_commit_entry(view, s->matched_commit);
+
+	s->search_commit = NULL;
+	stop_polling(&s->polling);
+
+	return rc;
+}
+
+/*
+ * If there are at least TL_SCAN_MIN loaded commits from sc->start in direction
+ * sc->dir, and more than one CPU, test them with a pool of tl_scan_thread()
+ * workers. Workers can't reload evicted chunks, so the scan ends before the
+ * first one. On return, sc->match is the index of the nearest match or -1,
+ * and sc->end is the last commit tested or, if none were, sc->start - sc->dir.
+ * fnc_mutex is held throughout so that no commits are published or evicted,
+ * but the user can cancel with backspace as with any search.
+ */
+static int
+tl_scan_commits(struct fnc_view *view, struct tl_scan *sc)
+{
+	struct fnc_tl_view_state	*s = &view->state.timeline;
+	struct commit_queue		*commits = &s->commits;
+	pthread_t			 tids[TL_SCAN_THREADS];
+	void				*ret;
+	long				 ncpu;
+	int				 c, i, n = 0, rc = 0, err;
+	bool				 done, failed = false;
+
+	sc->match = -1;
+	sc->end = sc->start - sc->dir;
+	sc->cancel = 0;
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu < 2 || s->thread_cx.search_re == NULL)
+		return rc;
+
+	i = sc->dir > 0 ? commits->ncommits - 1 : 0;
+	for (c = sc->start >> COMMIT_CHUNK_SHIFT;
+	    c != (i >> COMMIT_CHUNK_SHIFT) + sc->dir; c += sc->dir)
+		if (commits->chunks[c] == NULL) {
+			i = sc->dir > 0 ? (c << COMMIT_CHUNK_SHIFT) - 1 :
+			    (c + 1) << COMMIT_CHUNK_SHIFT;
+			break;
 		}
+	if ((i - sc->start) * sc->dir + 1 < TL_SCAN_MIN)
+		return rc;
+
+	sc->commits = commits;
+	sc->re = s->thread_cx.search_re;
+	sc->search_gen = s->thread_cx.search_gen;
+	sc->end = i;
+	sc->next = sc->start >> COMMIT_CHUNK_SHIFT;
+
+	if ((err = pthread_mutex_init(&sc->mutex, NULL))) {
+		sc->end = sc->start - sc->dir;
+		return RC(fsl_errno_to_rc(err, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_init");
 	}
 
-	s->search_commit = NULL;
+	/* Workers wait on the mutex until all are started. */
+	if ((err = pthread_mutex_lock(&sc->mutex))) {
+		rc = RC(fsl_errno_to_rc(err, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_lock");
+		goto end;
+	}
+	for (n = 0; n < MIN(ncpu, TL_SCAN_THREADS); ++n)
+		if (pthread_create(&tids[n], NULL, tl_scan_thread, sc))
+			break;
+	sc->nrunning = n;
+	/* Once a worker is started, it must be joined before we return. */
+	if ((err = pthread_mutex_unlock(&sc->mutex))) {
+		rc = RC(fsl_errno_to_rc(err, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_unlock");
+		sc->cancel = 1;
+	}
+
+	/* Poll for backspace until the workers are done or told to stop. */
 	cbreak();
+	wtimeout(view->window, 10);
+	while (!sc->cancel) {
+		if ((err = pthread_mutex_lock(&sc->mutex))) {
+			rc = RC(fsl_errno_to_rc(err, FSL_RC_ACCESS),
+			    "%s", "pthread_mutex_lock");
+			sc->cancel = 1;
+			break;
+		}
+		done = sc->nrunning == 0;
+		if ((err = pthread_mutex_unlock(&sc->mutex))) {
+			rc = RC(fsl_errno_to_rc(err, FSL_RC_ACCESS),
+			    "%s", "pthread_mutex_unlock");
+			sc->cancel = 1;
+			break;
+		}
+		if (done)
+			break;
+		if (wgetch(view->window) == KEY_BACKSPACE)
+			sc->cancel = 1;
+	}
+	wtimeout(view->window, -1);
+	reset_input_mode();
+
+	for (i = 0; i < n; ++i) {
+		if ((err = pthread_join(tids[i], &ret)) && !rc)
+			rc = RC(fsl_errno_to_rc(err, FSL_RC_ACCESS),
+			    "%s", "pthread_join");
+		else if (ret != NULL)
+			failed = true;
+	}
+	/* A worker that failed stopped the rest; it wasn't the user. */
+	if (failed)
+		sc->cancel = 0;
 
+end:
+	pthread_mutex_destroy(&sc->mutex);
+	/* If any worker failed, fall back to walking the commits in turn. */
+	if (rc || failed || n == 0) {
+		sc->match = -1;
+		sc->end = sc->start - sc->dir;
+	}
 	return rc;
 }
 
+static void *
+tl_scan_thread(void *arg)
+{
+	struct tl_scan		*sc = arg;
+	struct commit_chunk	*chunk;
+	regex_t			 regex;
+	int			 c, i, stop, rc, err;
+	bool			 compiled, found = false;
+
+	rc = block_main_thread_signals();
+	/* glibc serialises regexec() on each regex_t, so don't share one. */
+	if (!rc && regcomp(&regex, sc->re, REG_EXTENDED | REG_NEWLINE))
+		rc = FSL_RC_ERROR;
+	compiled = !rc;
+
+	if ((err = pthread_mutex_lock(&sc->mutex))) {
+		rc = fsl_errno_to_rc(err, FSL_RC_ACCESS);
+		goto end;
+	}
+	while (!rc && !sc->cancel) {
+		c = sc->next;
+		/* Done if past the end, which a reverse scan takes below 0. */
+		if ((c - (sc->end >> COMMIT_CHUNK_SHIFT)) * sc->dir > 0)
+			break;
+		if (c == sc->start >> COMMIT_CHUNK_SHIFT)
+			i = sc->start;
+		else
+			i = (c << COMMIT_CHUNK_SHIFT) |
+			    (sc->dir > 0 ? 0 : COMMIT_CHUNK_MASK);
+		/* Or if no nearer than the best match. */
+		if (sc->match >= 0 && (i - sc->match) * sc->dir > 0)
+			break;
+		sc->next += sc->dir;
+		if ((err = pthread_mutex_unlock(&sc->mutex))) {
+			rc = fsl_errno_to_rc(err, FSL_RC_ACCESS);
+			break;
+		}
+
+		chunk = sc->commits->chunks[c];
+		stop = (c << COMMIT_CHUNK_SHIFT) |
+		    (sc->dir > 0 ? COMMIT_CHUNK_MASK : 0);
+		if ((stop - sc->end) * sc->dir > 0)
+			stop = sc->end;
+		for (;; i += sc->dir) {
+			found = find_commit_match(
+			    chunk->entries[i & COMMIT_CHUNK_MASK].commit,
+			    &regex, sc->search_gen, true);
+			if (found || i == stop || sc->cancel)
+				break;
+		}
+
+		if ((err = pthread_mutex_lock(&sc->mutex))) {
+			rc = fsl_errno_to_rc(err, FSL_RC_ACCESS);
+			goto end;
+		}
+		if (found && (sc->match < 0 || (i - sc->match) * sc->dir < 0))
+			sc->match = i;
+	}
+	/* Don't leave the main thread waiting on a worker that's gone. */
+	--sc->nrunning;
+	if ((err = pthread_mutex_unlock(&sc->mutex)) && !rc)
+		rc = fsl_errno_to_rc(err, FSL_RC_ACCESS);
+end:
+	/* The scan is given up on error, so stop the other workers too. */
+	if (rc)
+		sc->cancel = 1;
+	if (compiled)
+		regfree(&regex);
+	return (void *)(intptr_t)rc;
+}
+
+/*
+ * Make from the literal strings that any match of the regex re must contain
+ * the tmp_fts MATCH expression of their trigrams and, if they are all
+ * lowercase hex, a GLOB on the commit hash. A literal is a run of ordinary or
+ * escaped chars outside any group or bracket expression, less a char made
+ * optional by a following '*', '?', or interval. Literals shorter than a
+ * trigram are of no use, and a regex with alternation has none, in which case
+ * the search loads and matches each commit as before. re itself is kept for
+ * the workers of tl_scan_commits().
+ */
+static int
+tl_search_terms(struct fnc_tl_thread_cx *cx, const char *re)
+{
+	fsl_buffer	 match = fsl_buffer_empty, glob = fsl_buffer_empty;
+	fsl_buffer	 run = fsl_buffer_empty;
+	const char	*p;
+	int		 depth = 0, rc = 0;
+	bool		 hex = true;
+
+	fsl_free(cx->search_re);
+	fsl_free(cx->fts_match);
+	fsl_free(cx->fts_glob);
+	cx->fts_match = NULL;
+	cx->fts_glob = NULL;
+
+	cx->search_re = fsl_strdup(re);
+	if (cx->search_re == NULL)
+		return RC(FSL_RC_ERROR, "%s", "fsl_strdup");
+
+	for (p = re; !rc; ++p) {
+		if (*p == '|' && !depth)
+			goto end;
+		switch (*p) {
+		case '\\':
+			if (p[1] != '\0' && !isalnum((unsigned char)p[1])) {
+				++p;
+				if (!depth)
+					rc = fsl_buffer_append(&run, p, 1);
+				continue;
+			}
+			if (p[1] != '\0')
+				++p;
+			break;
+		case '[':
+			if (*++p == '^')
+				++p;
+			if (*p == ']')
+				++p;
+			while (*p && *p != ']') {
+				if (*p == '[' && (p[1] == ':' || p[1] == '.' ||
+				    p[1] == '=')) {
+					char c = p[1];
+
+					for (p += 2; *p && (*p != c ||
+					    p[1] != ']'); ++p)
+						;
+					if (*p)
+						++p;
+				}
+				if (*p)
+					++p;
+			}
+			if (*p == '\0')
+				--p;
+			break;
+		case '(':
+			++depth;
+			break;
+		case ')':
+			if (depth)
+				--depth;
+			break;
+		case '*':
+		case '?':
+		case '{':
+			/* Drop the last UTF-8 char, which is optional. */
+			while (run.used && (run.mem[run.used - 1] & 0xc0) ==
+			    0x80)
+				--run.used;
+			if (run.used)
+				--run.used;
+			if (*p == '{') {
+				while (p[1] && *p != '}')
+					++p;
+				/* Unterminated: no literals. */
+				if (*p != '}')
+					goto end;
+			}
+			break;
+		case '+':
+		case '.':
+		case '^':
+		case '$':
+		case '\0':
+			break;
+		default:
+			if (!depth)
+				rc = fsl_buffer_append(&run, p, 1);
+			continue;
+		}
+		if (!rc)
+			rc = tl_search_term(&match, &glob, &hex, &run);
+		if (*p == '\0')
+			break;
+	}
+	if (rc) {
+		rc = RC(rc, "%s", "fsl_buffer_append");
+		goto end;
+	}
+
+	if (match.used)
+		cx->fts_match = fsl_buffer_take(&match);
+	if (hex && glob.used)
+		cx->fts_glob = fsl_buffer_take(&glob);
+end:
+	fsl_buffer_clear(&match);
+	fsl_buffer_clear(&glob);
+	fsl_buffer_clear(&run);
+	return rc;
+}
+
+/*
+ * Append the literal in run, if at least three UTF-8 chars, to the MATCH
+ * expression as an AND of its trigrams, and to the GLOB, then empty run.
+ * As trigrams may overlap, every third one and the last one will do.
+ */
+static int
+tl_search_term(fsl_buffer *match, fsl_buffer *glob, bool *hex,
+    fsl_buffer *run)
+{
+	const char	*str = (const char *)run->mem, *end, *a, *b;
+	fsl_size_t	 i;
+	int		 k, nchars = 0, rc = 0;
+
+	for (i = 0; i < run->used; ++i) {
+		if ((str[i] & 0xc0) != 0x80)
+			++nchars;
+		if (!isxdigit((unsigned char)str[i]) ||
+		    isupper((unsigned char)str[i]))
+			*hex = false;
+	}
+	if (nchars < 3)
+		goto end;
+	end = str + run->used;
+
+	for (a = str, k = 0; !rc; k += 3, a = b) {
+		if (k + 3 > nchars) {
+			/* Last trigram. */
+			for (a = end, i = 0; i < 3; ++i)
+				while ((*--a & 0xc0) == 0x80)
+					;
+		}
+		rc = fsl_buffer_append(match, match->used ? " AND \"" : "\"",
+		    -1);
+		for (b = a, i = 0; !rc && i < 3; ++i) {
+			do {
+				rc = fsl_buffer_append(match, b, 1);
+				if (!rc && *b == '"')
+					rc = fsl_buffer_append(match, b, 1);
+			} while (!rc && ++b < end && (*b & 0xc0) == 0x80);
+		}
+		if (!rc)
+			rc = fsl_buffer_append(match, "\"", 1);
+		if (b == end)
+			break;
+	}
+	if (!rc)
+		rc = fsl_buffer_appendf(glob, "%s%b*", glob->used ? "" : "*",
+		    run);
+end:
+	fsl_buffer_reuse(run);
+	return rc;
+}
+
+/*
+ * Look up the first commit after cx->search_key that matches the regex of a
+ * forward search in the tmp_fts index on the timeline thread's connection
+ * rather than by loading each commit and matching it in turn. The index is
+ * refreshed before each lookup, which first indexes whatever tl_fts_index()
+ * has yet to in the background. Each candidate, which contains the
+ * literals of the regex, is built and matched as if loaded. Set search_rid to
+ * the commit found, -1 if there is none, or leave it 0 if the index can't be
+ * used, in which case commits are loaded and matched as before. As commits
+ * are loaded in order, the timeline is still loaded up to the match. Must be
+ * called with fnc_mutex held, which is released while the index is queried.
+ */
+static int
+tl_fts_search(struct fnc_tl_thread_cx *cx)
+{
+	fsl_cx			*const f = fcli_cx();
+	struct commit_key	 key = cx->search_key;
+	char			*match, *glob = NULL;
+	fsl_id_t		 rid = -1;
+	int			 gen = cx->search_gen, rc, err;
+	bool			 done = false, failed = false, stale = false;
+
+	match = fsl_strdup(cx->fts_match);
+	if (cx->fts_glob)
+		glob = fsl_strdup(cx->fts_glob);
+	if (match == NULL || (cx->fts_glob && glob == NULL)) {
+		fsl_free(match);
+		return RC(FSL_RC_OOM, "%s", "fsl_strdup");
+	}
+
+	if ((rc = pthread_mutex_unlock(&fnc_mutex))) {
+		fsl_free(match);
+		fsl_free(glob);
+		return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_unlock");
+	}
+
+	rc = create_tmp_fts_table(cx->db, -1, &done);
+	if (!rc && cx->fts_q == NULL) {
+		cx->fts_q = fsl_stmt_malloc();
+		rc = cx->fts_q == NULL ? FSL_RC_OOM :
+		    fsl_db_prepare(cx->db, cx->fts_q, "%s", cx->fts_sql);
+	}
+	if (rc) {
+		/* Without FTS5 or its trigram tokenizer, search as before. */
+		if (cx->fts_q)
+			fsl_stmt_finalize(cx->fts_q);
+		cx->fts_q = NULL;
+		fsl_db_err_reset(cx->db);
+		rid = 0;
+		goto end;
+	}
+
+	rc = fsl_stmt_bind_double(cx->fts_q, 1, key.mtime);
+	if (!rc)
+		rc = fsl_stmt_bind_id(cx->fts_q, 2, key.rid);
+	if (!rc)
+		rc = fsl_stmt_bind_text(cx->fts_q, 3, match, -1, false);
+	if (!rc)
+		rc = glob ? fsl_stmt_bind_text(cx->fts_q, 4, glob, -1, false) :
+		    fsl_stmt_bind_null(cx->fts_q, 4);
+	if (rc) {
+		rc = RC(rc, "%s", "fsl_stmt_bind");
+		goto end;
+	}
+
+	while ((rc = fsl_stmt_step(cx->fts_q)) == FSL_RC_STEP_ROW) {
+		struct fnc_commit_artifact	*commit = NULL;
+		bool				 found = false;
+
+		rc = commit_builder(&commit, 0, cx->fts_q, NULL);
+		if (rc) {
+			failed = true;
+			break;
+		}
+		/* The regex is only valid while this search is. */
+		if ((rc = pthread_mutex_lock(&fnc_mutex))) {
+			fnc_commit_artifact_close(commit);
+			rc = RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+			    "%s", "pthread_mutex_lock");
+			break;
+		}
+		stale = gen != cx->search_gen || *cx->quit ||
+		    *cx->searching != SEARCH_FORWARD ||
+		    *cx->search_status != SEARCH_WAITING;
+		if (!stale)
+			found = find_commit_match(commit, cx->regex, gen,
+			    false);
+		if ((rc = pthread_mutex_unlock(&fnc_mutex))) {
+			fnc_commit_artifact_close(commit);
+			rc = RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+			    "%s", "pthread_mutex_unlock");
+			break;
+		}
+		if (found)
+			rid = commit->rid;
+		fnc_commit_artifact_close(commit);
+		if (found || stale)
+			break;
+	}
+	if (rc == FSL_RC_STEP_DONE)
+		rc = 0;
+	else if (rc == FSL_RC_STEP_ERROR)
+		rc = RC(fsl_cx_uplift_db_error2(f, cx->db, rc), "%s",
+		    "fsl_stmt_step");
+	fsl_stmt_reset(cx->fts_q);
+end:
+	fsl_free(match);
+	fsl_free(glob);
+	if ((err = pthread_mutex_lock(&fnc_mutex)))
+		return RC(fsl_errno_to_rc(err, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_lock");
+	if (failed)
+		rc = RC(rc, "%s", "commit_builder");
+	if (rid == 0) {
+		cx->search_fts = false;
+		cx->nofts = true;
+		fcli_err_reset();
+		return 0;
+	}
+	cx->fts_done = done;
+	/* Discard if the search was cancelled or has since moved on. */
+	if (rc || (!stale && gen == cx->search_gen &&
+	    key.mtime == cx->search_key.mtime &&
+	    key.rid == cx->search_key.rid)) {
+		cx->search_fts = false;
+		if (!rc && *cx->search_status == SEARCH_WAITING)
+			cx->search_rid = rid;
+	}
+	return rc;
+}
+
+/*
+ * Return true if regex matches any of the commit's user, hash, comment, or
+ * branch. The user and branch of timeline commits are interned, so they are
+ * tested once per search_gen rather than once per commit. If ro, results
+ * cached by an earlier test are used but not stored, as other threads may be
+ * testing the same strings.
+ */
 static bool
 find_commit_match(struct fnc_commit_artifact *commit,
-regex_t *regex)
+regex_t *regex, int search_gen, bool ro)
 {
 	regmatch_t	regmatch;
+	char		hex[FNC_HASH_HEXSZ];
+	bool		interned = commit->arena != NULL;
 
-	if (regexec(regex, commit->user, 1, &regmatch, 0) == 0 ||
-	    regexec(regex, (char *)commit->uuid, 1, &regmatch, 0) == 0 ||
+	if (match_str(commit->user, interned, regex, search_gen, ro) ||
+	    (fnc_hash_hex(&commit->uuid, hex) &&
+	     regexec(regex, hex, 1, &regmatch, 0) == 0) ||
 	    regexec(regex, commit->comment, 1, &regmatch, 0) == 0 ||
-	    (commit->branch && regexec(regex, commit->branch, 1, &regmatch, 0)
-	     == 0))
+	    (commit->branch && match_str(commit->branch, interned &&
+	     !FLAG_CHK(commit->heapstr, COMMIT_HEAP_BRANCH), regex,
+	     search_gen, ro)))
 		return true;
 
 	return false;
 }
 
+static bool
+match_str(const char *str, bool interned, regex_t *regex, int search_gen,
+    bool ro)
+{
+	struct fnc_istr	*istr;
+	regmatch_t	 regmatch;
+
+	if (!interned)
+		return regexec(regex, str, 1, &regmatch, 0) == 0;
+
+	istr = (struct fnc_istr *)(str - offsetof(struct fnc_istr, str));
+	if (ro && istr->search_gen != search_gen)
+		return regexec(regex, str, 1, &regmatch, 0) == 0;
+	if (istr->search_gen != search_gen) {
+		istr->match = regexec(regex, str, 1, &regmatch, 0) == 0;
+		istr->search_gen = search_gen;
+	}
+	return istr->match;
+}
+
 static int
 view_close(struct fnc_view *view)
 {
@@ -4093,8 +6041,34 @@ close_timeline_view(struct fnc_view *view)
 	int				 rc = 0;
 
 	rc = join_tl_thread(s);
-	fsl_stmt_finalize(s->thread_cx.q);
+	stop_polling(&s->polling);
+	if (s->thread_cx.q)
+		fsl_stmt_finalize(s->thread_cx.q);
+	s->thread_cx.q = NULL;
+	if (s->thread_cx.fts_q)
+		fsl_stmt_finalize(s->thread_cx.fts_q);
+	s->thread_cx.fts_q = NULL;
+	if (s->thread_cx.db)
+		fsl_db_close(s->thread_cx.db);
+	s->thread_cx.db = NULL;
 	fnc_free_commits(&s->commits);
+	if (s->commits.refetch)
+		fsl_stmt_finalize(s->commits.refetch);
+	if (s->commits.skip)
+		fsl_stmt_finalize(s->commits.skip);
+	if (s->commits.rskip)
+		fsl_stmt_finalize(s->commits.rskip);
+	if (s->commits.rank)
+		fsl_stmt_finalize(s->commits.rank);
+	fsl_free(s->commits.resume);
+	fsl_free(s->commits.keyset);
+	fsl_free(s->thread_cx.fts_sql);
+	fsl_free(s->thread_cx.search_re);
+	fsl_free(s->thread_cx.fts_match);
+	fsl_free(s->thread_cx.fts_glob);
+	s->thread_cx.fts_sql = NULL;
+	s->thread_cx.fts_match = NULL;
+	s->thread_cx.fts_glob = NULL;
 	free_colours(&s->colours);
 	regfree(&view->regex);
 	fsl_free(s->path);
@@ -4123,66 +6097,585 @@ join_tl_thread(struct fnc_tl_view_state *s)
 	void	*err;
 	int	 rc = 0;
 
-	if (s->thread_id) {
-		s->quit = 1;
+	if (s->thread_id) {
+		s->quit = 1;
+
+		if ((rc = pthread_cond_signal(&s->thread_cx.commit_consumer)))
+			return RC(fsl_errno_to_rc(rc, FSL_RC_MISUSE),
+			    "%s", "pthread_cond_signal");
+		if ((rc = pthread_mutex_unlock(&fnc_mutex)))
+			return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+			    "%s", "pthread_mutex_unlock");
+		if ((rc = pthread_join(s->thread_id, &err)) ||
+		    err == PTHREAD_CANCELED)
+			return RC(fsl_errno_to_rc(rc, FSL_RC_MISUSE),
+			    "%s", "pthread_join");
+		if ((rc = pthread_mutex_lock(&fnc_mutex)))
+			return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+			    "%s", "pthread_mutex_lock");
+
+		s->thread_id = 0;
+	}
+
+	if ((rc = pthread_cond_destroy(&s->thread_cx.commit_consumer)))
+		RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+		    "%s", "pthread_cond_destroy");
+
+	if ((rc = pthread_cond_destroy(&s->thread_cx.commit_producer)))
+		RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+		    "%s", "pthread_cond_destroy");
+
+	return rc;
+}
+
+/*
+ * Return the entry at idx, reloading its chunk if it was evicted, or NULL if
+ * there is no such entry or it could not be reloaded.
+ */
+static struct commit_entry *
+commit_queue_get(struct commit_queue *commits, int idx)
+{
+	int	chunk = idx >> COMMIT_CHUNK_SHIFT;
+
+	if (idx < 0 || idx >= commits->ncommits)
+		return NULL;
+
+	if (commits->chunks[chunk] == NULL &&
+	    commit_queue_load(commits, chunk))
+		return NULL;
+
+	return &commits->chunks[chunk]->entries[idx & COMMIT_CHUNK_MASK];
+}
+
+static struct commit_entry *
+commit_queue_next(struct commit_queue *commits, struct commit_entry *entry)
+{
+	return entry ? commit_queue_get(commits, entry->idx + 1) : NULL;
+}
+
+static struct commit_entry *
+commit_queue_prev(struct commit_queue *commits, struct commit_entry *entry)
+{
+	return entry ? commit_queue_get(commits, entry->idx - 1) : NULL;
+}
+
+/*
+ * Return the arena of the chunk that the next appended commit will be stored
+ * in, allocating the chunk if needed, or NULL on allocation failure. As the
+ * chunk table may be reallocated, the caller must hold fnc_mutex if the
+ * queue is shared with another thread.
+ */
+static struct fnc_arena *
+commit_queue_arena(struct commit_queue *commits)
+{
+	int	chunk = commits->ncommits >> COMMIT_CHUNK_SHIFT;
+
+	if (chunk >= commits->nchunks) {
+		struct commit_chunk	**chunks;
+		struct commit_key	 *keys;
+		int			  n = MAX(commits->nchunks * 2, 8);
+
+		/* Chunks skipped over by tl_seek_commits() are left unknown. */
+		n = MAX(n, chunk + 1);
+		chunks = fsl_realloc(commits->chunks, n * sizeof(*chunks));
+		if (chunks == NULL)
+			return NULL;
+		memset(chunks + commits->nchunks, 0,
+		    (n - commits->nchunks) * sizeof(*chunks));
+		commits->chunks = chunks;
+		keys = fsl_realloc(commits->keys, n * sizeof(*keys));
+		if (keys == NULL)
+			return NULL;
+		memset(keys + commits->nchunks, 0,
+		    (n - commits->nchunks) * sizeof(*keys));
+		commits->keys = keys;
+		commits->nchunks = n;
+	}
+	if (commits->chunks[chunk] == NULL) {
+		commits->chunks[chunk] = fsl_malloc(sizeof(**commits->chunks));
+		if (commits->chunks[chunk] == NULL)
+			return NULL;
+		memset(&commits->chunks[chunk]->arena, 0,
+		    sizeof(commits->chunks[chunk]->arena));
+		commits->grown = true;
+	}
+
+	return &commits->chunks[chunk]->arena;
+}
+
+/*
+ * Append commit, which must have been built in the arena returned by
+ * commit_queue_arena(), to the end of the queue. Entries never move, so
+ * pointers to them remain valid until fnc_free_commits() or, in windowed
+ * mode, until their chunk is evicted by tl_trim_commits().
+ */
+static int
+commit_queue_append(struct commit_queue *commits,
+    struct fnc_commit_artifact *commit)
+{
+	struct commit_entry	*entry;
+	int			 chunk;
+
+	if (commit_queue_arena(commits) == NULL)
+		return RC(FSL_RC_OOM, "%s", "commit_queue_arena");
+	chunk = commits->ncommits >> COMMIT_CHUNK_SHIFT;
+
+	entry = &commits->chunks[chunk]->entries[commits->ncommits &
+	    COMMIT_CHUNK_MASK];
+	entry->commit = commit;
+	entry->mtime = commit->mtime;
+	entry->rid = commit->rid;
+	entry->prid = commit->prid;
+	entry->idx = commits->ncommits++;
+	if ((entry->idx & COMMIT_CHUNK_MASK) == 0) {
+		commits->keys[chunk].mtime = entry->mtime;
+		commits->keys[chunk].rid = entry->rid;
+	}
+
+	return FSL_RC_OK;
+}
+
+/*
+ * Reload evicted chunk from the keyset of its first commit. As the timeline
+ * isn't refreshed while open, the same commits are expected in the same
+ * order; if the repository changed such that they aren't, fail rather than
+ * shift the indices of every commit after the chunk.
+ */
+static int
+commit_queue_load(struct commit_queue *commits, int chunk)
+{
+	struct commit_chunk	*c;
+	struct commit_key	*key = &commits->keys[chunk];
+	fsl_stmt		*q;
+	int			 idx, n, rc;
+
+	if ((rc = commit_queue_prepare(commits, true)) ||
+	    (rc = commit_queue_key(commits, chunk)))
+		return rc;
+	q = commits->refetch;
+
+	n = MIN(COMMIT_CHUNK_SZ,
+	    commits->ncommits - (chunk << COMMIT_CHUNK_SHIFT));
+
+	c = fsl_malloc(sizeof(*c));
+	if (c == NULL)
+		return RC(FSL_RC_OOM, "%s", "fsl_malloc");
+	memset(&c->arena, 0, sizeof(c->arena));
+
+	/* Inclusive of the first commit: objid < rid + 1. */
+	rc = fsl_stmt_bind_double(q, 1, key->mtime);
+	if (!rc)
+		rc = fsl_stmt_bind_id(q, 2, key->rid + 1);
+	if (!rc && fsl_stmt_param_count(q) > 2)
+		rc = fsl_stmt_bind_int32(q, 3, n);
+	if (rc) {
+		rc = RC(rc, "%s", "fsl_stmt_bind");
+		n = 0;
+	}
+
+	for (idx = 0; idx < n; ++idx) {
+		struct commit_entry		*entry = &c->entries[idx];
+		struct fnc_commit_artifact	*commit = NULL;
+
+		rc = fsl_stmt_step(q);
+		if (rc != FSL_RC_STEP_ROW) {
+			rc = RC(rc == FSL_RC_STEP_DONE ? FSL_RC_NOT_FOUND : rc,
+			    "%s", "timeline changed since loaded");
+			break;
+		}
+		rc = commit_builder(&commit, 0, q, &c->arena);
+		if (rc) {
+			rc = RC(rc, "%s", "commit_builder");
+			break;
+		}
+		if (idx == 0 && commit->rid != key->rid) {
+			fnc_commit_artifact_close(commit);
+			rc = RC(FSL_RC_NOT_FOUND, "%s",
+			    "timeline changed since loaded");
+			break;
+		}
+		entry->commit = commit;
+		entry->mtime = commit->mtime;
+		entry->rid = commit->rid;
+		entry->prid = commit->prid;
+		entry->idx = (chunk << COMMIT_CHUNK_SHIFT) + idx;
+	}
+	fsl_stmt_reset(q);
+
+	if (rc) {
+		while (idx--)
+			fnc_commit_artifact_close(c->entries[idx].commit);
+		fnc_arena_free(&c->arena);
+		fsl_free(c);
+		return rc;
+	}
+
+	commits->chunks[chunk] = c;
+	commits->grown = true;
+	return FSL_RC_OK;
+}
+
+/*
+ * Prepare the stmts that commits are reloaded and skipped over with on the
+ * fsl_cx connection, if not yet prepared, along with the temp tables they
+ * use. As tmp_tagmap takes a while to build, it and refetch are only made if
+ * reload is true.
+ */
+static int
+commit_queue_prepare(struct commit_queue *commits, bool reload)
+{
+	fsl_db	*db = fsl_cx_db_repo(fcli_cx());
+	int	 rc = FSL_RC_OK;
+
+	if (commits->rank == NULL) {
+		if (commits->root)
+			rc = create_tmp_ancestor_table(db, commits->root,
+			    fnc_init.nrecords.limit);
+		if (rc)
+			return rc;
+		commits->skip = fsl_stmt_malloc();
+		commits->rskip = fsl_stmt_malloc();
+		commits->rank = fsl_stmt_malloc();
+		rc = fsl_db_prepare(db, commits->skip, "%s"
+		    " AND event.mtime <= ?1"
+		    " AND (event.mtime < ?1 OR event.objid < ?2)"
+		    " ORDER BY event.mtime DESC, event.objid DESC"
+		    " LIMIT 1 OFFSET ?3", commits->keyset);
+		if (!rc)
+			rc = fsl_db_prepare(db, commits->rskip, "%s"
+			    " AND event.mtime >= ?1"
+			    " AND (event.mtime > ?1 OR event.objid > ?2)"
+			    " ORDER BY event.mtime, event.objid"
+			    " LIMIT 1 OFFSET ?3", commits->keyset);
+		if (!rc)
+			rc = fsl_db_prepare(db, commits->rank, "SELECT count(*)"
+			    " FROM (%s AND event.mtime >= ?1"
+			    " AND (event.mtime > ?1 OR event.objid > ?2))",
+			    commits->keyset);
+		if (rc)
+			return RC(rc, "%s", "fsl_db_prepare");
+	}
+
+	if (reload && commits->refetch == NULL) {
+		if ((rc = create_tmp_tagmap_table(db)))
+			return rc;
+		commits->refetch = fsl_stmt_malloc();
+		rc = fsl_db_prepare(db, commits->refetch, "%s",
+		    commits->resume);
+		if (rc)
+			return RC(rc, "%s", "fsl_db_prepare");
+	}
+
+	return rc;
+}
+
+/*
+ * If chunk was skipped over by tl_seek_commits(), find the key of its first
+ * commit by skipping from the key of the nearest chunk either side that is
+ * known. Neither the first chunk nor the last is ever skipped.
+ */
+static int
+commit_queue_key(struct commit_queue *commits, int chunk)
+{
+	int	lo, hi, rc;
+
+	if (commits->keys[chunk].rid)
+		return FSL_RC_OK;
+
+	for (lo = chunk - 1; !commits->keys[lo].rid; --lo)
+		;
+	for (hi = chunk + 1; !commits->keys[hi].rid; ++hi)
+		;
+	if (hi - chunk < chunk - lo)
+		rc = commit_queue_skip(commits, &commits->keys[chunk],
+		    &commits->keys[hi], (chunk - hi) << COMMIT_CHUNK_SHIFT);
+	else
+		rc = commit_queue_skip(commits, &commits->keys[chunk],
+		    &commits->keys[lo], (chunk - lo) << COMMIT_CHUNK_SHIFT);
+
+	if (rc == FSL_RC_STEP_DONE)
+		rc = RC(FSL_RC_NOT_FOUND, "%s",
+		    "timeline changed since loaded");
+	return rc;
+}
+
+/*
+ * Assign to *ret the key of the commit n commits after the one at key, or
+ * before it if n is negative, which needn't be on the timeline itself. Only
+ * the event index is stepped through, so no commit is built. Return
+ * FSL_RC_STEP_DONE if there is no such commit.
+ */
+static int
+commit_queue_skip(struct commit_queue *commits, struct commit_key *ret,
+    const struct commit_key *key, int n)
+{
+	fsl_stmt	*q = n < 0 ? commits->rskip : commits->skip;
+	int		 rc;
+
+	/* Skipping forward is inclusive of key: objid < rid + 1. */
+	rc = fsl_stmt_bind_double(q, 1, key->mtime);
+	if (!rc)
+		rc = fsl_stmt_bind_id(q, 2, n < 0 ? key->rid : key->rid + 1);
+	if (!rc)
+		rc = fsl_stmt_bind_int32(q, 3, n < 0 ? -n - 1 : n);
+	if (rc) {
+		fsl_stmt_reset(q);
+		return RC(rc, "%s", "fsl_stmt_bind");
+	}
+
+	rc = fsl_stmt_step(q);
+	if (rc == FSL_RC_STEP_ROW) {
+		ret->mtime = fsl_stmt_g_double(q, 0);
+		ret->rid = fsl_stmt_g_id(q, 1);
+		rc = FSL_RC_OK;
+	} else if (rc != FSL_RC_STEP_DONE)
+		rc = RC(rc, "%s", "fsl_stmt_step");
+	fsl_stmt_reset(q);
+
+	return rc;
+}
+
+static void
+commit_queue_evict(struct commit_queue *commits, int chunk)
+{
+	struct commit_chunk	*c = commits->chunks[chunk];
+	int			 idx, n;
+
+	if (c == NULL)
+		return;
+
+	n = MIN(COMMIT_CHUNK_SZ,
+	    commits->ncommits - (chunk << COMMIT_CHUNK_SHIFT));
+	for (idx = 0; idx < n; ++idx)
+		fnc_commit_artifact_close(c->entries[idx].commit);
+	fnc_arena_free(&c->arena);
+	fsl_free(c);
+	commits->chunks[chunk] = NULL;
+}
+
+static void
+fnc_free_commits(struct commit_queue *commits)
+{
+	int	idx;
+
+	for (idx = 0; idx < commits->nchunks; ++idx)
+		commit_queue_evict(commits, idx);
+	fsl_free(commits->chunks);
+	fsl_free(commits->keys);
+	commits->chunks = NULL;
+	commits->keys = NULL;
+	commits->nchunks = 0;
+	commits->ncommits = 0;
+}
+
+static void *
+fnc_arena_alloc(struct fnc_arena *arena, size_t n)
+{
+	struct fnc_arena_block	*b = arena->head;
+	void			*p;
+
+	/* Keep every allocation aligned like the block's mem. */
+	n = (n + sizeof(*b->mem) - 1) & ~(sizeof(*b->mem) - 1);
+
+	if (b == NULL || b->size - b->used < n) {
+		size_t sz = MAX(ARENA_BLOCK_SZ, n);
+
+		b = fsl_malloc(sizeof(*b) + sz);
+		if (b == NULL)
+			return NULL;
+		b->next = arena->head;
+		b->used = 0;
+		b->size = sz;
+		arena->head = b;
+		arena->nbytes += sz;
+	}
+
+	p = (char *)b->mem + b->used;
+	b->used += n;
+	return p;
+}
+
+/*
+ * Copy str into arena, or onto the heap if arena is NULL. Return NULL if str
+ * is NULL or memory is exhausted.
+ */
+static char *
+fnc_arena_strdup(struct fnc_arena *arena, const char *str)
+{
+	char	*dup;
+	size_t	 len;
+
+	if (arena == NULL)
+		return fsl_strdup(str);
+	if (str == NULL)
+		return NULL;
+
+	len = fsl_strlen(str) + 1;
+	dup = fnc_arena_alloc(arena, len);
+	if (dup)
+		memcpy(dup, str, len);
+	return dup;
+}
+
+/*
+ * Return the copy of str interned in arena, adding it if this is the first
+ * time str has been seen. If arena is NULL, return a heap copy of str as per
+ * fnc_arena_strdup(). Return NULL if str is NULL or memory is exhausted.
+ */
+static char *
+fnc_arena_intern(struct fnc_arena *arena, const char *str)
+{
+	struct fnc_istr	*istr;
+	uint32_t	 hash = 2166136261u, idx;  /* FNV-1a */
+	size_t		 len;
+
+	if (arena == NULL)
+		return fsl_strdup(str);
+	if (str == NULL)
+		return NULL;
+
+	for (len = 0; str[len]; ++len)
+		hash = (hash ^ (unsigned char)str[len]) * 16777619u;
 
-		if ((rc = pthread_cond_signal(&s->thread_cx.commit_consumer)))
-			return RC(fsl_errno_to_rc(rc, FSL_RC_MISUSE),
-			    "%s", "pthread_cond_signal");
-		if ((rc = pthread_mutex_unlock(&fnc_mutex)))
-			return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
-			    "%s", "pthread_mutex_unlock");
-		if ((rc = pthread_join(s->thread_id, &err)) ||
-		    err == PTHREAD_CANCELED)
-			return RC(fsl_errno_to_rc(rc, FSL_RC_MISUSE),
-			    "%s", "pthread_join");
-		if ((rc = pthread_mutex_lock(&fnc_mutex)))
-			return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
-			    "%s", "pthread_mutex_lock");
+	if (arena->nstrs >= arena->nslots / 2) {
+		struct fnc_istr	**strtab;
+		uint32_t	  n = MAX(arena->nslots * 2, 64), i;
 
-		s->thread_id = 0;
+		strtab = calloc(n, sizeof(*strtab));
+		if (strtab == NULL)
+			return NULL;
+		for (i = 0; i < arena->nslots; ++i) {
+			if ((istr = arena->strtab[i]) == NULL)
+				continue;
+			idx = istr->hash & (n - 1);
+			while (strtab[idx])
+				idx = (idx + 1) & (n - 1);
+			strtab[idx] = istr;
+		}
+		fsl_free(arena->strtab);
+		arena->strtab = strtab;
+		arena->nslots = n;
 	}
 
-	if ((rc = pthread_cond_destroy(&s->thread_cx.commit_consumer)))
-		RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
-		    "%s", "pthread_cond_destroy");
+	idx = hash & (arena->nslots - 1);
+	while ((istr = arena->strtab[idx])) {
+		if (istr->hash == hash && !strcmp(istr->str, str))
+			return istr->str;
+		idx = (idx + 1) & (arena->nslots - 1);
+	}
 
-	if ((rc = pthread_cond_destroy(&s->thread_cx.commit_producer)))
-		RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
-		    "%s", "pthread_cond_destroy");
+	istr = fnc_arena_alloc(arena, sizeof(*istr) + len + 1);
+	if (istr == NULL)
+		return NULL;
+	istr->hash = hash;
+	istr->search_gen = 0;
+	istr->match = false;
+	memcpy(istr->str, str, len + 1);
+	arena->strtab[idx] = istr;
+	++arena->nstrs;
 
-	return rc;
+	return istr->str;
 }
 
 static void
-fnc_free_commits(struct commit_queue *commits)
+fnc_arena_free(struct fnc_arena *arena)
 {
-	while (!TAILQ_EMPTY(&commits->head)) {
-		struct commit_entry	*entry;
+	while (arena->head) {
+		struct fnc_arena_block *b = arena->head;
 
-		entry = TAILQ_FIRST(&commits->head);
-		TAILQ_REMOVE(&commits->head, entry, entries);
-		fnc_commit_artifact_close(entry->commit);
-		free(entry);
-		--commits->ncommits;
+		arena->head = b->next;
+		fsl_free(b);
 	}
+	fsl_free(arena->strtab);
+	arena->strtab = NULL;
+	arena->nslots = 0;
+	arena->nstrs = 0;
+	arena->nbytes = 0;
+}
+
+/*
+ * Decode hex hash into h. If hex is NULL, h is set to the empty hash. Return
+ * FSL_RC_RANGE, without reporting it, if hex isn't a valid hash; timeline
+ * threads call this without fnc_mutex.
+ */
+static int
+fnc_hash_decode(struct fnc_hash *h, const char *hex)
+{
+	fsl_size_t	len = fsl_strlen(hex);
+
+	h->len = 0;
+	if (hex == NULL)
+		return FSL_RC_OK;
+	if (len == 0 || len > FNC_HASH_MAX * 2 || len & 1 ||
+	    fsl_decode16((const unsigned char *)hex, h->d, len))
+		return FSL_RC_RANGE;
+
+	h->len = len / 2;
+	return FSL_RC_OK;
+}
+
+/*
+ * Set h to the hash of artifact rid, or to the empty hash if there is no
+ * such artifact (e.g., the parent of the initial commit).
+ */
+static int
+fnc_hash_from_rid(struct fnc_hash *h, fsl_id_t rid)
+{
+	fsl_uuid_str	id = NULL;
+	int		rc;
+
+	if (rid > 0)
+		id = fsl_rid_to_uuid(fcli_cx(), rid);
+	rc = fnc_hash_decode(h, id);
+	if (rc)
+		rc = RC(rc, "invalid hash: %s", id);
+	fsl_free(id);
+	return rc;
 }
 
+/*
+ * Write the hex form of h to buf, which must be at least FNC_HASH_HEXSZ bytes,
+ * and return buf; or return NULL if h is empty.
+ */
+static char *
+fnc_hash_hex(const struct fnc_hash *h, char *buf)
+{
+	if (h->len == 0)
+		return NULL;
+
+	fsl_encode16(h->d, (unsigned char *)buf, h->len);
+	return buf;
+}
+
+static bool
+fnc_hash_eq(const struct fnc_hash *h1, const struct fnc_hash *h2)
+{
+	return h1->len == h2->len && !memcmp(h1->d, h2->d, h1->len);
+}
+
+/*
+ * Commits built into an arena own none of their strings, save for those the
+ * diff view assigned after the fact (flagged in heapstr); the rest goes when
+ * the arena is freed with the timeline's commits.
+ */
 static void
 fnc_commit_artifact_close(struct fnc_commit_artifact *commit)
 {
+	if (commit->arena) {
+		if (FLAG_CHK(commit->heapstr, COMMIT_HEAP_BRANCH))
+			fsl_free(commit->branch);
+		commit->heapstr = 0;
+		fsl_list_clear(&commit->changeset, fsl_file_artifact_free,
+		    NULL);
+		fsl_list_reserve(&commit->changeset, 0);
+		return;
+	}
 	if (commit->branch)
 		fsl_free(commit->branch);
 	if (commit->comment)
 		fsl_free(commit->comment);
-	if (commit->timestamp)
-		fsl_free(commit->timestamp);
-	if (commit->type)
-		fsl_free(commit->type);
 	if (commit->user)
 		fsl_free(commit->user);
-	fsl_free(commit->uuid);
-	fsl_free(commit->puuid);
 	fsl_list_clear(&commit->changeset, fsl_file_artifact_free, NULL);
 	fsl_list_reserve(&commit->changeset, 0);
 	fsl_free(commit);
@@ -4244,10 +6737,16 @@ open_diff_view(struct fnc_view *view, struct fnc_commit_artifact *commit,
 	s->first_line_onscreen = 1;
 	s->last_line_onscreen = view->nlines;
 	s->selected_line = 1;
-	s->f = NULL;
+	s->text = fsl_buffer_empty;
+	s->thread_cx.d1 = fsl_deck_empty;
+	s->thread_cx.d2 = fsl_deck_empty;
+	TAILQ_INIT(&s->cache);
+	s->cachesz = 0;
+	s->cachemax = diff_cache_max();
 	s->context = context;
 	s->sbs = 0;
 	FLAG_SET(s->diff_flags, FNC_DIFF_PROTOTYPE);
+	FLAG_SET(s->diff_flags, FNC_DIFF_STRIP_EOLCR);
 	verbosity ? FLAG_SET(s->diff_flags, FNC_DIFF_VERBOSE) : 0;
 	ignore_ws ? FLAG_SET(s->diff_flags, FNC_DIFF_IGNORE_ALLWS) : 0;
 	invert ? FLAG_SET(s->diff_flags, FNC_DIFF_INVERT) : 0;
@@ -4268,6 +6767,7 @@ open_diff_view(struct fnc_view *view, struct fnc_commit_artifact *commit,
 	show_diff_status(view);
 
 	s->line_offsets = NULL;
+	s->noffsets = 0;
 	s->nlines = 0;
 	s->ncols = view->ncols;
 	rc = create_diff(s);
@@ -4296,60 +6796,50 @@ show_diff_status(struct fnc_view *view)
 static int
 create_diff(struct fnc_diff_view_state *s)
 {
-	FILE	*fout = NULL;
-	char	*line, *st0 = NULL, *st = NULL;
-	off_t	 lnoff = 0;
-	uint32_t idx = 0;
-	int	 rc = 0;
-
-	free(s->line_offsets);
-	s->line_offsets = fsl_malloc(sizeof(off_t));
-	if (s->line_offsets == NULL)
-		return RC(FSL_RC_ERROR, "%s", "fsl_malloc");
-	s->nlines = 0;
+	int	rc = 0;
 
-	fout = tmpfile();
-	if (fout == NULL) {
-		rc = RC(fsl_errno_to_rc(errno, FSL_RC_IO), "%s", "tmpfile");
-		goto end;
-	}
-	if (s->f && fclose(s->f) == EOF) {
-		rc = RC(fsl_errno_to_rc(errno, FSL_RC_IO), "%s", "fclose");
-		goto end;
+	/* Make the diff in the memory of the last one. */
+	fsl_buffer_reuse(&s->text);
+	if (s->line_offsets == NULL) {
+		s->line_offsets = fsl_malloc(sizeof(off_t));
+		if (s->line_offsets == NULL)
+			return RC(FSL_RC_ERROR, "%s", "fsl_malloc");
+		s->noffsets = 1;
 	}
-	s->f = fout;
+	s->line_offsets[0] = 0;
+	s->nlines = 0;
 
 	/*
 	 * We'll diff artifacts of type "ci" (i.e., "checkin") separately, as
 	 * it's a different process to diff the others (wiki, technote, etc.).
 	 */
-	if (s->selected_commit->diff_type == FNC_DIFF_COMMIT)
-		rc = create_changeset(s->selected_commit);
-	else if (s->selected_commit->diff_type == FNC_DIFF_BLOB)
-		rc = diff_file_artifact(s, s->selected_commit->prid, NULL,
-		    NULL, FSL_CKOUT_CHANGE_MOD);
-	else if (s->selected_commit->diff_type == FNC_DIFF_WIKI)
-		rc = diff_non_checkin(&s->buf, s->selected_commit,
-		    s->diff_flags, s->context, s->sbs);
-	if (rc)
+	if (s->selected_commit->diff_type == FNC_DIFF_WIKI &&
+	    (rc = diff_non_checkin(&s->buf, s->selected_commit,
+	    s->diff_flags, s->context, s->sbs)))
 		goto end;
 
 	/*
 	 * Delay assigning diff headline labels (i.e., diff id1 id2) till now
 	 * because wiki parent commits are obtained in diff_non_checkin().
 	 */
-	if (s->selected_commit->puuid) {
+	if (s->selected_commit->puuid.len) {
+		char hex[FNC_HASH_HEXSZ];
+
 		fsl_free(s->id1);
-		s->id1 = fsl_strdup(s->selected_commit->puuid);
+		s->id1 = fsl_strdup(fnc_hash_hex(&s->selected_commit->puuid,
+		    hex));
 		if (s->id1 == NULL) {
 			rc = RC(FSL_RC_ERROR, "%s", "fsl_strdup");
 			goto end;
 		}
 	} else
 		s->id1 = NULL;	/* Initial commit, tag, technote, etc. */
-	if (s->selected_commit->uuid) {
+	if (s->selected_commit->uuid.len) {
+		char hex[FNC_HASH_HEXSZ];
+
 		fsl_free(s->id2);
-		s->id2 = fsl_strdup(s->selected_commit->uuid);
+		s->id2 = fsl_strdup(fnc_hash_hex(&s->selected_commit->uuid,
+		    hex));
 		if (s->id2 == NULL) {
 			rc = RC(FSL_RC_ERROR, "%s", "fsl_strdup");
 			goto end;
@@ -4357,50 +6847,37 @@ create_diff(struct fnc_diff_view_state *s)
 	} else
 		s->id2 = NULL;	/* Local work tree. */
 
-	rc = add_line_offset(&s->line_offsets, &s->nlines, 0);
-	if (rc)
+	if (s->selected_commit->diff_type == FNC_DIFF_COMMIT ||
+	    s->selected_commit->diff_type == FNC_DIFF_BLOB) {
+		struct fnc_diff_key	key;
+		bool			hit;
+
+		diff_key(s, &key);
+		if ((rc = diff_cache_get(s, &key, &hit)) || hit)
+			goto end;
+	}
+	if (s->selected_commit->diff_type == FNC_DIFF_COMMIT &&
+	    (rc = create_changeset(s->selected_commit)))
 		goto end;
 
-	if (s->showmeta)
-		write_commit_meta(s);
+	if (s->showmeta && (rc = write_commit_meta(s)))
+		goto end;
 
 	/*
 	 * Diff local changes on disk in the current checkout differently to
 	 * checked-in versions: the former compares on disk file content with
-	 * file artifacts; the latter compares file artifact blobs only.
+	 * file artifacts; the latter compares file artifact blobs only. The
+	 * latter is done on the diff thread, and is shown as it's made.
 	 */
-	if (s->selected_commit->diff_type == FNC_DIFF_COMMIT)
-		diff_commit(s);
+	if (s->selected_commit->diff_type == FNC_DIFF_COMMIT ||
+	    s->selected_commit->diff_type == FNC_DIFF_BLOB)
+		rc = start_diff(s);
 	else if (s->selected_commit->diff_type == FNC_DIFF_CKOUT)
 		diff_checkout(s);
-
-	/*
-	 * Parse the diff buffer line-by-line to record byte offsets of each
-	 * line for scrolling and searching in diff view.
-	 */
-	st0 = fsl_strdup(fsl_buffer_str(&s->buf));
-	st = st0;
-	lnoff = (s->line_offsets)[s->nlines - 1];
-	s->index.lineno = fsl_malloc(s->index.n * sizeof(size_t));
-	while ((line = fnc_strsep(&st, "\n")) != NULL) {
-		int lineno, n = fprintf(s->f, "%s\n", line);
-		s->maxx = MAX((int)s->maxx, n);
-		if (s->index.offset && idx < s->index.n &&
-		    lnoff == s->index.offset[idx]) {
-			lineno = s->nlines + (idx ? 1 : 0);
-			s->index.lineno[idx++] = lineno;
-		}
-		lnoff += n;
-		rc = add_line_offset(&s->line_offsets, &s->nlines, lnoff);
-		if (rc)
-			goto end;
-	}
-	--s->nlines;  /* Don't count EOF '\n' */
+	else if (s->selected_commit->diff_type == FNC_DIFF_WIKI)
+		rc = add_diff_lines(s, &s->buf, false);
 end:
-	fsl_free(st0);
 	fsl_buffer_clear(&s->buf);
-	if (s->f && fflush(s->f) != 0 && rc == 0)
-		rc = RC(FSL_RC_IO, "%s", "fflush");
 	return rc;
 }
 
@@ -4459,6 +6936,9 @@ create_changeset(struct fnc_commit_artifact *commit)
 		fsl_list_append(&changeset, fdiff);
 	}
 
+	/* Drop the changeset built when this commit was last diffed. */
+	fsl_list_clear(&commit->changeset, fsl_file_artifact_free, NULL);
+	fsl_list_reserve(&commit->changeset, 0);
 	commit->changeset = changeset;
 	fsl_stmt_finalize(st);
 
@@ -4471,122 +6951,92 @@ create_changeset(struct fnc_commit_artifact *commit)
 static int
 write_commit_meta(struct fnc_diff_view_state *s)
 {
+	fsl_buffer	 buf = fsl_buffer_empty;
 	char		*line = NULL, *st0 = NULL, *st = NULL;
+	char		 hex[FNC_HASH_HEXSZ], datestr[ISO8601_TIMESTAMP];
+	const char	*date;
 	fsl_size_t	 linelen, idx = 0;
-	off_t		 lnoff = 0;
-	int		 n, rc = 0;
-
-	if ((n = fprintf(s->f,"%s %s\n", s->selected_commit->type,
-	    s->selected_commit->uuid)) < 0)
-		goto end;
-	lnoff += n;
-	if ((rc = add_line_offset(&s->line_offsets, &s->nlines, lnoff)))
-		goto end;
-
-	if ((n = fprintf(s->f,"user: %s\n", s->selected_commit->user)) < 0)
-		goto end;
-	lnoff += n;
-	if ((rc = add_line_offset(&s->line_offsets, &s->nlines, lnoff)))
-		goto end;
-
-	if ((n = fprintf(s->f,"tags: %s\n", s->selected_commit->branch ?
-	    s->selected_commit->branch : "/dev/null")) < 0)
-		goto end;
-	lnoff += n;
-	if ((rc = add_line_offset(&s->line_offsets, &s->nlines, lnoff)))
-		goto end;
-
-	if ((n = fprintf(s->f,"date: %s\n",
-	    s->selected_commit->timestamp)) < 0)
-		goto end;
-	lnoff += n;
-	if ((rc = add_line_offset(&s->line_offsets, &s->nlines, lnoff)))
-		goto end;
+	int		 rc = 0;
 
-	fputc('\n', s->f);
-	++lnoff;
-	if ((rc = add_line_offset(&s->line_offsets, &s->nlines, lnoff)))
+	date = fnc_mtime_to_str(s->selected_commit->mtime, datestr,
+	    sizeof(datestr));
+	rc = fsl_buffer_appendf(&buf, "%s %s\nuser: %s\ntags: %s\ndate: %s\n\n",
+	    s->selected_commit->type,
+	    fnc_hash_hex(&s->selected_commit->uuid, hex),
+	    s->selected_commit->user, s->selected_commit->branch ?
+	    s->selected_commit->branch : "/dev/null",
+	    date ? date : "unknown");
+	if (rc) {
+		rc = RC(rc, "%s", "fsl_buffer_appendf");
 		goto end;
+	}
 
 	st0 = fsl_strdup(s->selected_commit->comment);
 	st = st0;
 	if (st == NULL) {
-		RC(FSL_RC_ERROR, "%s", "fsl_strdup");
+		rc = RC(FSL_RC_ERROR, "%s", "fsl_strdup");
 		goto end;
 	}
 	while ((line = fnc_strsep(&st, "\n")) != NULL) {
 		linelen = fsl_strlen(line);
-		if (linelen >= s->ncols) {
-			rc = wrapline(line, s->ncols - LINENO_WIDTH, s, &lnoff);
-			if (rc)
-				goto end;
-		}
-		else {
-			if ((n = fprintf(s->f, "%s\n", line)) < 0)
-				goto end;
-			lnoff += n;
-			if ((rc = add_line_offset(&s->line_offsets, &s->nlines,
-			    lnoff)))
-				goto end;
-
-		}
+		if (linelen >= s->ncols)
+			rc = wrapline(line, s->ncols - LINENO_WIDTH, &buf);
+		else if ((rc = fsl_buffer_appendf(&buf, "%s\n", line)))
+			rc = RC(rc, "%s", "fsl_buffer_appendf");
+		if (rc)
+			goto end;
 	}
 
-	fputc('\n', s->f);
-	++lnoff;
-	if ((rc = add_line_offset(&s->line_offsets, &s->nlines, lnoff)))
+	if ((rc = fsl_buffer_append(&buf, "\n", 1))) {
+		rc = RC(rc, "%s", "fsl_buffer_append");
 		goto end;
+	}
 
 	if (s->selected_commit->diff_type == FNC_DIFF_WIKI)
-		goto end;  /* No changeset for wiki commits. */
+		goto add;  /* No changeset for wiki commits. */
 
 	for (idx = 0; idx < s->selected_commit->changeset.used; ++idx) {
-		char				*changeline;
 		struct fsl_file_artifact	*file_change;
 
 		file_change = s->selected_commit->changeset.list[idx];
 
 		switch (file_change->change) {
 		case FSL_CKOUT_CHANGE_MOD:
-			changeline = "[~] ";
+			rc = fsl_buffer_append(&buf, "[~] ", -1);
 			break;
 		case FSL_CKOUT_CHANGE_ADDED:
-			changeline = "[+] ";
+			rc = fsl_buffer_append(&buf, "[+] ", -1);
 			break;
 		case FSL_CKOUT_CHANGE_RENAMED:
-			changeline = fsl_mprintf("[>] %s -> ",
+			rc = fsl_buffer_appendf(&buf, "[>] %s -> ",
 			   file_change->fc->priorName);
 			break;
 		case FSL_CKOUT_CHANGE_REMOVED:
-			changeline = "[-] ";
+			rc = fsl_buffer_append(&buf, "[-] ", -1);
 			break;
 		default:
-			changeline = "[!] ";
+			rc = fsl_buffer_append(&buf, "[!] ", -1);
 			break;
 		}
-		if ((n = fprintf(s->f, "%s%s\n", changeline,
-		    file_change->fc->name)) < 0)
-			goto end;
-		lnoff += n;
-		if ((rc = add_line_offset(&s->line_offsets, &s->nlines, lnoff)))
+		if (!rc)
+			rc = fsl_buffer_appendf(&buf, "%s\n",
+			    file_change->fc->name);
+		if (rc) {
+			rc = RC(rc, "%s", "fsl_buffer_appendf");
 			goto end;
+		}
 	}
 
 	/* Add blank line between end of changeset and diff. */
-	fputc('\n', s->f);
-	++lnoff;
-	rc = add_line_offset(&s->line_offsets, &s->nlines, lnoff);
-	s->index.offset = fsl_realloc(s->index.offset,
-	    (s->index.n + 1) * sizeof(off_t));
-	s->index.offset[s->index.n++] = lnoff;
+	if ((rc = fsl_buffer_append(&buf, "\n", 1))) {
+		rc = RC(rc, "%s", "fsl_buffer_append");
+		goto end;
+	}
+add:
+	rc = add_diff_lines(s, &buf, false);
 end:
+	fsl_buffer_clear(&buf);
 	free(st0);
-	free(line);
-	if (rc) {
-		free(*&s->line_offsets);
-		s->line_offsets = NULL;
-		s->nlines = 0;
-	}
 	return rc;
 }
 
@@ -4596,58 +7046,426 @@ end:
  * screen is currently split, and not mistakenly pass in the curses COLS macro
  * without deducting the parent panel's width. This function doesn't break
  * words, and will wrap at the end of the last word that can wholly fit within
- * the ncols_avail limit.
+ * the ncols_avail limit. The wrapped lines are appended to buf.
  */
 static int
-wrapline(char *line, fsl_size_t ncols_avail, struct fnc_diff_view_state *s,
-    off_t *lnoff)
+wrapline(char *line, fsl_size_t ncols_avail, fsl_buffer *buf)
 {
 	char		*word;
 	fsl_size_t	 wordlen, cursor = 0;
-	int		 n = 0, rc = 0;
+	int		 rc = 0;
 
 	while ((word = fnc_strsep(&line, " ")) != NULL) {
 		wordlen = fsl_strlen(word);
 		if ((cursor + wordlen) >= ncols_avail) {
-			fputc('\n', s->f);
-			++(*lnoff);
-			rc = add_line_offset(&s->line_offsets, &s->nlines,
-			    *lnoff);
-			if (rc)
-				return rc;
+			if ((rc = fsl_buffer_append(buf, "\n", 1)))
+				return RC(rc, "%s", "fsl_buffer_append");
 			cursor = 0;
 		}
-		if ((n  = fprintf(s->f, "%s ", word)) < 0)
+		if ((rc = fsl_buffer_appendf(buf, "%s ", word)))
+			return RC(rc, "%s", "fsl_buffer_appendf");
+		cursor += wordlen + 1;
+	}
+	if ((rc = fsl_buffer_append(buf, "\n", 1)))
+		return RC(rc, "%s", "fsl_buffer_append");
+
+	return 0;
+}
+
+/*
+ * Count another line, which ends at offset off in s->text. line_offsets[n] is
+ * the offset of line n + 1, so line_offsets[nlines] is the end of the last.
+ * The array is doubled when full, so indexing a big diff doesn't realloc
+ * once per line.
+ */
+static int
+add_line_offset(struct fnc_diff_view_state *s, off_t off)
+{
+	off_t	*p;
+
+	if (s->nlines + 2 > s->noffsets) {
+		size_t n = MAX(s->noffsets * 2, s->nlines + 2);
+
+		p = fsl_realloc(s->line_offsets, n * sizeof(*p));
+		if (p == NULL)
+			return RC(FSL_RC_ERROR, "%s", "fsl_realloc");
+		s->line_offsets = p;
+		s->noffsets = n;
+	}
+	s->line_offsets[++s->nlines] = off;
+
+	return 0;
+}
+
+/*
+ * Append the lines in buf to the diff. If file is true, buf is the diff of a
+ * file, so index the line it starts on for file navigation, and separate it
+ * from the previous file's diff with a blank line. Lines are kept in s->text
+ * with their newline replaced by a NUL, so that they can be drawn and
+ * searched where they lie. Caller must hold fnc_mutex while the diff thread
+ * is running, as s->text may move when it grows.
+ */
+static int
+add_diff_lines(struct fnc_diff_view_state *s, const fsl_buffer *buf,
+    bool file)
+{
+	fsl_buffer	*text = &s->text;
+	char		*line, *end, *eol;
+	size_t		*lineno;
+	fsl_size_t	 need;
+	int		 rc;
+
+	/*
+	 * Room for buf, a blank line before it, a NUL in lieu of a newline
+	 * if its last line lacks one, and the buffer's terminating NUL.
+	 */
+	need = text->used + buf->used + 3;
+	if (need > text->capacity) {
+		rc = fsl_buffer_reserve(text, MAX(text->capacity * 2, need));
+		if (rc)
+			return RC(rc, "%s", "fsl_buffer_reserve");
+	}
+
+	if (file) {
+		if (s->index.n && !FLAG_CHK(s->diff_flags,
+		    (FNC_DIFF_SIDEBYSIDE | FNC_DIFF_BRIEF))) {
+			text->mem[text->used++] = '\0';
+			if ((rc = add_line_offset(s, text->used)))
+				return rc;
+		}
+		lineno = fsl_realloc(s->index.lineno,
+		    (s->index.n + 1) * sizeof(*lineno));
+		if (lineno == NULL)
+			return RC(FSL_RC_ERROR, "%s", "fsl_realloc");
+		s->index.lineno = lineno;
+		s->index.lineno[s->index.n++] = s->nlines + 1;
+	}
+
+	line = (char *)text->mem + text->used;
+	memcpy(line, buf->mem, buf->used);
+	end = line + buf->used;
+	for (; line < end; line = eol + 1) {
+		eol = memchr(line, '\n', end - line);
+		if (eol == NULL)
+			eol = end++;
+		*eol = '\0';
+		s->maxx = MAX(s->maxx, (int)(eol - line + 1));
+		rc = add_line_offset(s, eol + 1 - (char *)text->mem);
+		if (rc)
+			return rc;
+	}
+	text->used = end - (char *)text->mem;
+	text->mem[text->used] = '\0';
+
+	return FSL_RC_OK;
+}
+
+/*
+ * Start diffing the selected version or blob on the diff thread, opening the
+ * read-only clone of fcli_cx() it uses if this is the first time. If the
+ * version changes at least DIFF_POOL_MIN files and there is more than one
+ * CPU, open clones for the workers that share its files too. The tasks of the
+ * last version diffed are dropped if this is another one.
+ */
+static int
+start_diff(struct fnc_diff_view_state *s)
+{
+	struct fnc_diff_thread_cx	*cx = &s->thread_cx;
+	char				 pid[FNC_HASH_HEXSZ] = "";
+	long				 ncpu;
+	int				 rc;
+
+	if (cx->f == NULL && (rc = fnc_cx_clone(&cx->f)))
+		return rc;
+
+	cx->nworkers = 0;
+	if (s->selected_commit->diff_type == FNC_DIFF_COMMIT &&
+	    s->selected_commit->changeset.used >= DIFF_POOL_MIN) {
+		ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		cx->nworkers = MAX(MIN(ncpu, DIFF_THREADS) - 1, 0);
+	}
+	while (cx->npool < cx->nworkers) {
+		rc = fnc_cx_clone(&cx->pool[cx->npool].f);
+		if (rc)
 			return rc;
-		*lnoff += n;
-		cursor += n;
+		cx->pool[cx->npool++].cx = cx;
+	}
+
+	if (s->selected_commit->puuid.len)
+		fnc_hash_hex(&s->selected_commit->puuid, pid);
+	if (cx->rid != s->selected_commit->rid ||
+	    cx->prid != s->selected_commit->prid ||
+	    cx->type != s->selected_commit->diff_type || strcmp(cx->pid, pid))
+		free_diff_tasks(cx);	/* Kept for another version. */
+
+	cx->s = s;
+	cx->paths = s->paths;
+	cx->rid = s->selected_commit->rid;
+	cx->prid = s->selected_commit->prid;
+	memcpy(cx->pid, pid, sizeof(cx->pid));
+	cx->type = s->selected_commit->diff_type;
+	cx->diff_flags = s->diff_flags;
+	cx->context = s->context;
+	cx->sbs = s->sbs;
+	diff_key(s, &cx->key);
+	cx->rc = FSL_RC_OK;
+	cx->quit = false;
+	cx->complete = false;
+	cx->whole = false;
+
+	rc = pthread_create(&s->thread_id, NULL, diff_thread, cx);
+	if (rc) {
+		s->thread_id = 0;
+		return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+		    "%s", "pthread_create");
+	}
+	start_polling(&s->polling);	/* Refresh as the diff is made. */
+
+	return FSL_RC_OK;
+}
+
+/*
+ * Wait for the diff thread to finish, or tell it to stop first if cancel is
+ * true, and return the error it stopped on, if any. Caller must hold
+ * fnc_mutex.
+ */
+static int
+stop_diff(struct fnc_diff_view_state *s, bool cancel)
+{
+	struct fnc_diff_thread_cx	*cx = &s->thread_cx;
+	int				 rc;
+
+	if (!s->thread_id)
+		return FSL_RC_OK;
+
+	if (cancel)
+		cx->quit = true;
+	if ((rc = pthread_mutex_unlock(&fnc_mutex)))
+		return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_unlock");
+	if ((rc = pthread_join(s->thread_id, NULL)))
+		return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+		    "%s", "pthread_join");
+	if ((rc = pthread_mutex_lock(&fnc_mutex)))
+		return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_lock");
+	s->thread_id = 0;
+	stop_polling(&s->polling);
+
+	/*
+	 * The content and diffs the tasks keep share the cache's limit, and
+	 * are dropped rather than the cache if they'd fill it on their own.
+	 */
+	cx->tasksz = diff_tasks_size(cx);
+	if (cx->tasksz > s->cachemax)
+		free_diff_tasks(cx);
+	while (s->cachesz + cx->tasksz > s->cachemax)
+		diff_cache_evict(s, TAILQ_LAST(&s->cache, fnc_diff_cache));
+
+	if (!cancel && cx->whole && (rc = diff_cache_put(s, &cx->key)))
+		return rc;
+
+	return cx->rc;
+}
+
+/*
+ * Return the size in bytes of the diff view cache as set with FNC_DIFF_CACHE
+ * in MiB, or DIFF_CACHE_MB if it's not set or invalid.
+ */
+static size_t
+diff_cache_max(void)
+{
+	char	*mb = NULL;
+	long	 n = DIFF_CACHE_MB;
+	int	 rc = FSL_RC_OK;
+
+	mb = fnc_conf_getopt(FNC_DIFF_CACHE, false);
+	if (mb)
+		rc = strtonumcheck(&n, mb, 0, MAX_DIFF_CACHE);
+
+	fsl_free(mb);
+	return (size_t)(rc ? DIFF_CACHE_MB : n) << 20;
+}
+
+static void
+diff_key(struct fnc_diff_view_state *s, struct fnc_diff_key *key)
+{
+	key->uuid = s->selected_commit->uuid;
+	key->puuid = s->selected_commit->puuid;
+	key->diff_flags = s->diff_flags;
+	key->context = s->context;
+	key->sbs = s->sbs;
+	key->ncols = s->showmeta ? s->ncols : 0;
+}
+
+static bool
+diff_key_eq(const struct fnc_diff_key *k1, const struct fnc_diff_key *k2)
+{
+	return fnc_hash_eq(&k1->uuid, &k2->uuid) &&
+	    fnc_hash_eq(&k1->puuid, &k2->puuid) &&
+	    k1->diff_flags == k2->diff_flags && k1->context == k2->context &&
+	    k1->sbs == k2->sbs && k1->ncols == k2->ncols;
+}
+
+/*
+ * If the diff of key is in the cache, copy it and its indexes to the view,
+ * make it the most recently used, and set *hit.
+ */
+static int
+diff_cache_get(struct fnc_diff_view_state *s, const struct fnc_diff_key *key,
+    bool *hit)
+{
+	struct fnc_diff_cached	*c;
+	off_t			*offsets;
+	size_t			*lineno;
+	int			 rc;
+
+	*hit = false;
+	TAILQ_FOREACH(c, &s->cache, entry)
+		if (diff_key_eq(&c->key, key))
+			break;
+	if (c == NULL)
+		return FSL_RC_OK;
+
+	fsl_buffer_reuse(&s->text);
+	rc = fsl_buffer_append(&s->text, c->text.mem, c->text.used);
+	if (rc)
+		return RC(rc, "%s", "fsl_buffer_append");
+	if (s->noffsets < c->nlines + 1) {
+		offsets = fsl_realloc(s->line_offsets,
+		    (c->nlines + 1) * sizeof(*offsets));
+		if (offsets == NULL)
+			return RC(FSL_RC_ERROR, "%s", "fsl_realloc");
+		s->line_offsets = offsets;
+		s->noffsets = c->nlines + 1;
+	}
+	memcpy(s->line_offsets, c->line_offsets,
+	    (c->nlines + 1) * sizeof(off_t));
+	s->nlines = c->nlines;
+	if (c->nfiles) {
+		lineno = fsl_realloc(s->index.lineno,
+		    c->nfiles * sizeof(*lineno));
+		if (lineno == NULL)
+			return RC(FSL_RC_ERROR, "%s", "fsl_realloc");
+		memcpy(lineno, c->lineno, c->nfiles * sizeof(*lineno));
+		s->index.lineno = lineno;
+	}
+	s->index.n = c->nfiles;
+	s->index.idx = 0;
+	s->maxx = MAX(s->maxx, c->maxx);
+
+	TAILQ_REMOVE(&s->cache, c, entry);
+	TAILQ_INSERT_HEAD(&s->cache, c, entry);
+	*hit = true;
+
+	return FSL_RC_OK;
+}
+
+/*
+ * Copy the finished diff in the view, which was made as described by key, to
+ * the cache. Evict the least recently used diffs to make room for it, unless
+ * it's bigger than the room the diff tasks leave, in which case don't keep it.
+ */
+static int
+diff_cache_put(struct fnc_diff_view_state *s, const struct fnc_diff_key *key)
+{
+	struct fnc_diff_cached	*c;
+	size_t			 size;
+	int			 rc;
+
+	size = sizeof(*c) + s->text.used + (s->nlines + 1) * sizeof(off_t) +
+	    s->index.n * sizeof(size_t);
+	if (size > s->cachemax - s->thread_cx.tasksz)
+		return FSL_RC_OK;
+
+	c = fsl_malloc(sizeof(*c));
+	if (c == NULL)
+		return RC(FSL_RC_ERROR, "%s", "fsl_malloc");
+	c->key = *key;
+	c->text = fsl_buffer_empty;
+	c->nlines = s->nlines;
+	c->nfiles = s->index.n;
+	c->maxx = s->maxx;
+	c->size = size;
+	c->line_offsets = fsl_malloc((c->nlines + 1) * sizeof(off_t));
+	c->lineno = c->nfiles ? fsl_malloc(c->nfiles * sizeof(size_t)) : NULL;
+	if (c->line_offsets == NULL || (c->nfiles && c->lineno == NULL)) {
+		rc = RC(FSL_RC_ERROR, "%s", "fsl_malloc");
+		goto end;
 	}
-	fputc('\n', s->f);
-	++(*lnoff);
-	if ((rc = add_line_offset(&s->line_offsets, &s->nlines, *lnoff)))
-		return rc;
+	rc = fsl_buffer_append(&c->text, s->text.mem, s->text.used);
+	if (rc) {
+		rc = RC(rc, "%s", "fsl_buffer_append");
+		goto end;
+	}
+	memcpy(c->line_offsets, s->line_offsets,
+	    (c->nlines + 1) * sizeof(off_t));
+	if (c->nfiles)
+		memcpy(c->lineno, s->index.lineno, c->nfiles * sizeof(size_t));
 
-	return 0;
+	while (s->cachesz + size + s->thread_cx.tasksz > s->cachemax)
+		diff_cache_evict(s, TAILQ_LAST(&s->cache, fnc_diff_cache));
+	TAILQ_INSERT_HEAD(&s->cache, c, entry);
+	s->cachesz += size;
+end:
+	if (rc) {
+		fsl_buffer_clear(&c->text);
+		fsl_free(c->line_offsets);
+		fsl_free(c->lineno);
+		fsl_free(c);
+	}
+	return rc;
 }
 
-static int
-add_line_offset(off_t **line_offsets, size_t *nlines, off_t off)
+static void
+diff_cache_evict(struct fnc_diff_view_state *s, struct fnc_diff_cached *c)
 {
-	off_t	*p;
+	TAILQ_REMOVE(&s->cache, c, entry);
+	s->cachesz -= c->size;
+	fsl_buffer_clear(&c->text);
+	fsl_free(c->line_offsets);
+	fsl_free(c->lineno);
+	fsl_free(c);
+}
 
-	p = fsl_realloc(*line_offsets, (*nlines + 1) * sizeof(off_t));
-	if (p == NULL)
-		return RC(FSL_RC_ERROR, "%s", "fsl_realloc");
-	*line_offsets = p;
-	(*line_offsets)[*nlines] = off;
-	(*nlines)++;
+/*
+ * Diff the version or blob on the thread's own clone of fcli_cx(), so that
+ * the main thread can draw and scroll what's been diffed so far while the
+ * rest is. fnc_mutex is only taken to add each file's diff to the view.
+ */
+static void *
+diff_thread(void *state)
+{
+	struct fnc_diff_thread_cx	*cx = state;
+	int				 rc, err;
 
-	return 0;
+	rc = block_main_thread_signals();
+	if (!rc && cx->type == FNC_DIFF_BLOB) {
+		cx->id1 = cx->prid;
+		if (!cx->ntasks)
+			rc = add_diff_task(cx, NULL, NULL,
+			    FSL_CKOUT_CHANGE_MOD);
+		if (!rc)
+			rc = run_diff_tasks(cx);
+	} else if (!rc)
+		rc = diff_commit(cx);
+
+	if ((err = pthread_mutex_lock(&fnc_mutex)))
+		return (void *)(intptr_t)RC(fsl_errno_to_rc(err,
+		    FSL_RC_ACCESS), "%s", "pthread_mutex_lock");
+	cx->rc = rc;
+	cx->whole = !rc && !cx->quit;
+	cx->complete = true;
+	if ((err = pthread_mutex_unlock(&fnc_mutex)) && !rc)
+		rc = RC(fsl_errno_to_rc(err, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_unlock");
+
+	return (void *)(intptr_t)rc;
 }
 
 /*
- * Fill the buffer with the differences between commit->uuid and commit->puuid.
- * commit->rid (to load into deck d2) is the *this* version, and commit->puuid
+ * Add the differences between cx->rid and its parent cx->pid to the view.
+ * cx->rid (to load into deck d2) is the *this* version, and cx->pid
  * (to be loaded into deck d1) is the version we diff against. Step through the
  * deck of F(ile) cards from both versions to determine: (1) if we have new
  * files added (i.e., no F card counterpart in d1); (2) files deleted (i.e., no
@@ -4656,24 +7474,29 @@ add_line_offset(off_t **line_offsets, size_t *nlines, off_t off)
  * to dump the complete content of the added/deleted file if FNC_DIFF_VERBOSE is
  * set, otherwise only diff metatadata will be output. In case (3), if the
  * hash (UUID) of each F card is the same, there are no changes; if different,
- * both artifacts will be passed to diff_file_artifact() to be diffed.
+ * both artifacts will be passed to diff_file_artifact() to be diffed. Each
+ * file to diff is made a task for run_diff_tasks(), unless the tasks were
+ * already made when the version was last diffed, in which case they're done
+ * again.
  */
 static int
-diff_commit(struct fnc_diff_view_state *s)
+diff_commit(struct fnc_diff_thread_cx *cx)
 {
-	fsl_cx			*const f = fcli_cx();
+	fsl_cx			*const f = cx->f;
+	fsl_deck		*const d1 = &cx->d1;
+	fsl_deck		*const d2 = &cx->d2;
 	const fsl_card_F	*fc1 = NULL;
 	const fsl_card_F	*fc2 = NULL;
-	fsl_deck		 d1 = fsl_deck_empty;
-	fsl_deck		 d2 = fsl_deck_empty;
-	fsl_id_t		 id1;
 	int			 different = 0, rc = 0;
 
-	rc = fsl_deck_load_rid(f, &d2, s->selected_commit->rid,
-	    FSL_SATYPE_CHECKIN);
+	if (cx->ntasks)
+		goto run;
+
+	free_diff_tasks(cx);	/* Drop the decks of a version with none. */
+	rc = fsl_deck_load_rid(f, d2, cx->rid, FSL_SATYPE_CHECKIN);
 	if (rc)
 		goto end;
-	rc = fsl_deck_F_rewind(&d2);
+	rc = fsl_deck_F_rewind(d2);
 	if (rc)
 		goto end;
 
@@ -4682,30 +7505,30 @@ diff_commit(struct fnc_diff_view_state *s)
 	 * canonical fnc, that do not have an "initial empty check-in", we
 	 * proceed with no parent version to diff against.
 	 */
-	if (s->selected_commit->puuid) {
-		rc = fsl_sym_to_rid(f, s->selected_commit->puuid,
-		    FSL_SATYPE_CHECKIN, &id1);
+	cx->id1 = 0;
+	if (cx->pid[0]) {
+		rc = fsl_sym_to_rid(f, cx->pid, FSL_SATYPE_CHECKIN, &cx->id1);
 		if (rc)
 			goto end;
-		rc = fsl_deck_load_rid(f, &d1, id1, FSL_SATYPE_CHECKIN);
+		rc = fsl_deck_load_rid(f, d1, cx->id1, FSL_SATYPE_CHECKIN);
 		if (rc)
 			goto end;
-		rc = fsl_deck_F_rewind(&d1);
+		rc = fsl_deck_F_rewind(d1);
 		if (rc)
 			goto end;
-		fsl_deck_F_next(&d1, &fc1);
+		fsl_deck_F_next(d1, &fc1);
 	}
 
-	fsl_deck_F_next(&d2, &fc2);
+	fsl_deck_F_next(d2, &fc2);
 	while (fc1 || fc2) {
 		const fsl_card_F	*a = NULL, *b = NULL;
 		fsl_ckout_change_e	 change = FSL_CKOUT_CHANGE_NONE;
 		bool			 diff = true;
 
-		if (s->paths != NULL && !TAILQ_EMPTY(s->paths)) {
+		if (cx->paths != NULL && !TAILQ_EMPTY(cx->paths)) {
 			struct fnc_pathlist_entry *pe;
 			diff = false;
-			TAILQ_FOREACH(pe, s->paths, entry)
+			TAILQ_FOREACH(pe, cx->paths, entry)
 				if (!fsl_strcmp(pe->path, fc1->name) ||
 				    !fsl_strcmp(pe->path, fc2->name) ||
 				    !fsl_strncmp(pe->path, fc1->name,
@@ -4727,41 +7550,225 @@ diff_commit(struct fnc_diff_view_state *s)
 			if (different > 0) {
 				b = fc2;
 				change = FSL_CKOUT_CHANGE_ADDED;
-				fsl_deck_F_next(&d2, &fc2);
+				fsl_deck_F_next(d2, &fc2);
 			} else if (different < 0) {
 				a = fc1;
 				change = FSL_CKOUT_CHANGE_REMOVED;
-				fsl_deck_F_next(&d1, &fc1);
+				fsl_deck_F_next(d1, &fc1);
 			}
 			if (diff)
-				rc = diff_file_artifact(s, id1, a, b, change);
+				rc = add_diff_task(cx, a, b, change);
 		} else if (!fsl_uuidcmp(fc1->uuid, fc2->uuid)) { /* No change */
-			fsl_deck_F_next(&d1, &fc1);
-			fsl_deck_F_next(&d2, &fc2);
+			fsl_deck_F_next(d1, &fc1);
+			fsl_deck_F_next(d2, &fc2);
 		} else {
 			change = FSL_CKOUT_CHANGE_MOD;
 			if (diff)
-				rc = diff_file_artifact(s, id1, fc1, fc2,
-				    change);
-			fsl_deck_F_next(&d1, &fc1);
-			fsl_deck_F_next(&d2, &fc2);
+				rc = add_diff_task(cx, fc1, fc2, change);
+			fsl_deck_F_next(d1, &fc1);
+			fsl_deck_F_next(d2, &fc2);
 		}
-		if (rc == FSL_RC_RANGE) {
-			fsl_buffer_append(&s->buf,
-			    "\nDiff has too many changes\n", -1);
-			rc = 0;
-			fsl_cx_err_reset(f);
-		} else if (rc == FSL_RC_DIFF_BINARY) {
-			fsl_buffer_append(&s->buf,
-			    "\nBinary files cannot be diffed\n", -1);
-			rc = 0;
-			fsl_cx_err_reset(f);
-		} else if (rc)
+		if (rc)
 			goto end;
 	}
+
+run:
+	return run_diff_tasks(cx);
 end:
-	fsl_deck_finalize(&d1);
-	fsl_deck_finalize(&d2);
+	free_diff_tasks(cx);
+	return rc;
+}
+
+/*
+ * Add the diff of F-cards a and b to the tasks of cx; the cards must outlive
+ * the tasks. The list is grown in powers of two.
+ */
+static int
+add_diff_task(struct fnc_diff_thread_cx *cx, const fsl_card_F *a,
+    const fsl_card_F *b, fsl_ckout_change_e change)
+{
+	struct fnc_diff_task	*tasks;
+	int			 n = cx->ntasks;
+
+	if ((n & (n - 1)) == 0) {
+		tasks = fsl_realloc(cx->tasks, MAX(n * 2, 1) * sizeof(*tasks));
+		if (tasks == NULL)
+			return RC(FSL_RC_ERROR, "%s", "fsl_realloc");
+		cx->tasks = tasks;
+	}
+	cx->tasks[n].a = a;
+	cx->tasks[n].b = b;
+	cx->tasks[n].buf = fsl_buffer_empty;
+	cx->tasks[n].blob1 = fsl_buffer_empty;
+	cx->tasks[n].blob2 = fsl_buffer_empty;
+	cx->tasks[n].diff = fnc_diff_empty;
+	cx->tasks[n].zminus = cx->tasks[n].zplus = NULL;
+	cx->tasks[n].xminus = cx->tasks[n].xplus = NULL;
+	cx->tasks[n].change = change;
+	cx->tasks[n].fetched = false;
+	cx->tasks[n].done = false;
+	++cx->ntasks;
+
+	return FSL_RC_OK;
+}
+
+/*
+ * Diff the tasks of cx on this thread and, if start_diff() found the commit
+ * big enough to share, on as many of the workers in cx->pool as there are
+ * tasks for. Return the first error any of them stopped on, which is copied
+ * from the clone of the thread it stopped to fcli once they're all done.
+ */
+static int
+run_diff_tasks(struct fnc_diff_thread_cx *cx)
+{
+	fsl_cx	*ef = cx->f;
+	void	*ret;
+	int	 i, n, rc, err;
+
+	for (i = 0; i < cx->ntasks; ++i)
+		cx->tasks[i].done = false;
+	cx->next = cx->npublished = 0;
+
+	for (n = 0; n < MIN(cx->nworkers, cx->ntasks - 1); ++n)
+		if (pthread_create(&cx->pool[n].id, NULL, diff_worker,
+		    &cx->pool[n]))
+			break;	/* Make do with those we have. */
+
+	rc = diff_tasks(cx, cx->f);
+
+	for (i = 0; i < n; ++i) {
+		if ((err = pthread_join(cx->pool[i].id, &ret)) && !rc)
+			rc = fsl_cx_err_set(cx->f,
+			    fsl_errno_to_rc(err, FSL_RC_ACCESS),
+			    "%s", "pthread_join");
+		else if (ret != NULL && !rc) {
+			rc = (intptr_t)ret;
+			ef = cx->pool[i].f;
+		}
+	}
+	for (i = 0; i < cx->ntasks; ++i)
+		fsl_buffer_clear(&cx->tasks[i].buf);
+
+	if (rc && fsl_cx_err_get(ef, NULL, NULL) &&
+	    !(err = pthread_mutex_lock(&fnc_mutex))) {
+		RC(rc, "%b", &fsl_cx_err_get_e(ef)->msg);
+		pthread_mutex_unlock(&fnc_mutex);
+	}
+	fsl_cx_err_reset(cx->f);
+	for (i = 0; i < cx->npool; ++i)
+		fsl_cx_err_reset(cx->pool[i].f);
+
+	return rc;
+}
+
+/*
+ * Return the bytes held by the tasks of cx, with the content of the files
+ * they diffed and their prepared diffs.
+ */
+static size_t
+diff_tasks_size(const struct fnc_diff_thread_cx *cx)
+{
+	const struct fnc_diff_task	*t;
+	const fsl__diff_cx		*c;
+	size_t				 size;
+	int				 i;
+
+	size = cx->ntasks * sizeof(*t);
+	for (i = 0; i < cx->ntasks; ++i) {
+		t = &cx->tasks[i];
+		c = &t->diff.c;
+		size += t->buf.capacity + t->blob1.capacity +
+		    t->blob2.capacity;
+		size += ((size_t)c->nFrom + c->nTo) * sizeof(fsl_dline) +
+		    c->nEditAlloc * sizeof(int);
+	}
+	return size;
+}
+
+/*
+ * Free the tasks of cx, with the content of the files they diffed, and the
+ * decks their F-cards are in. Must not be called while the diff thread runs.
+ */
+static void
+free_diff_tasks(struct fnc_diff_thread_cx *cx)
+{
+	struct fnc_diff_task	*t;
+	int			 i;
+
+	for (i = 0; i < cx->ntasks; ++i) {
+		t = &cx->tasks[i];
+		fsl_buffer_clear(&t->buf);
+		fsl_buffer_clear(&t->blob1);
+		fsl_buffer_clear(&t->blob2);
+		fnc_diff_free(&t->diff);
+		fsl_free(t->zminus);
+		fsl_free(t->zplus);
+		fsl_free(t->xminus);
+		fsl_free(t->xplus);
+	}
+	fsl_free(cx->tasks);
+	cx->tasks = NULL;
+	cx->ntasks = cx->next = cx->npublished = 0;
+	cx->tasksz = 0;
+	fsl_deck_finalize(&cx->d1);
+	fsl_deck_finalize(&cx->d2);
+}
+
+static void *
+diff_worker(void *arg)
+{
+	struct fnc_diff_worker	*w = arg;
+
+	/* Signals are blocked by the diff thread we were started from. */
+	return (void *)(intptr_t)diff_tasks(w->cx, w->f);
+}
+
+/*
+ * Diff the next task of cx not yet taken by another thread with f, until
+ * none are left or the diff thread is told to stop. Once a task is done, it
+ * and any done after it are added to the view, unless a task before them is
+ * still being diffed, in which case the thread diffing it adds them when it's
+ * done. If a task fails, the other threads are stopped. As the threads run
+ * at once, errors are set in f rather than with RC(), except those of
+ * add_diff_lines(), which is called with fnc_mutex held.
+ */
+static int
+diff_tasks(struct fnc_diff_thread_cx *cx, fsl_cx *f)
+{
+	struct fnc_diff_task	*t;
+	int			 rc = 0, err;
+
+	if ((err = pthread_mutex_lock(&fnc_mutex)))
+		return fsl_cx_err_set(f, fsl_errno_to_rc(err, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_lock");
+	while (!cx->quit && cx->next < cx->ntasks) {
+		t = &cx->tasks[cx->next++];
+		if ((err = pthread_mutex_unlock(&fnc_mutex)))
+			return fsl_cx_err_set(f,
+			    fsl_errno_to_rc(err, FSL_RC_ACCESS),
+			    "%s", "pthread_mutex_unlock");
+		rc = diff_file_artifact(cx, f, t);
+		if ((err = pthread_mutex_lock(&fnc_mutex)))
+			return fsl_cx_err_set(f,
+			    fsl_errno_to_rc(err, FSL_RC_ACCESS),
+			    "%s", "pthread_mutex_lock");
+		t->done = true;
+		while (!rc && cx->npublished < cx->next &&
+		    cx->tasks[cx->npublished].done) {
+			t = &cx->tasks[cx->npublished++];
+			if (t->buf.used)
+				rc = add_diff_lines(cx->s, &t->buf, true);
+			fsl_buffer_clear(&t->buf);
+		}
+		if (rc) {
+			cx->quit = true;
+			break;
+		}
+	}
+	if ((err = pthread_mutex_unlock(&fnc_mutex)) && !rc)
+		rc = fsl_cx_err_set(f, fsl_errno_to_rc(err, FSL_RC_ACCESS),
+		    "%s", "pthread_mutex_unlock");
+
 	return rc;
 }
 
@@ -4915,8 +7922,11 @@ diff_checkout(struct fnc_diff_view_state *s)
 			    NULL_DEVICE, s->diff_flags, change);
 			fsl_buffer_append(&s->buf,
 			    "\nSymbolic links cannot be diffed\n", -1);
+			if (!rc)
+				rc = add_diff_lines(s, &s->buf, true);
 			if (rc)
 				goto yield;
+			fsl_buffer_reuse(&s->buf);
 			continue;
 		}
 		if (fid > 0 && change != FSL_CKOUT_CHANGE_ADDED) {
@@ -4954,6 +7964,9 @@ diff_checkout(struct fnc_diff_view_state *s)
 			fsl_cx_err_reset(f);
 		} else if (rc)
 			goto yield;
+		if (s->buf.used && (rc = add_diff_lines(s, &s->buf, true)))
+			goto yield;
+		fsl_buffer_reuse(&s->buf);
 	}
 
 yield:
@@ -5116,9 +8129,6 @@ diff_file(struct fnc_diff_view_state *s, fsl_buffer *bminus, const char *zminus,
 	if (rc)
 		goto end;
 
-	s->index.offset = fsl_realloc(s->index.offset,
-	    (s->index.n + 1) * sizeof(off_t));
-	s->index.offset[s->index.n++] = s->buf.used;
 	rc = write_diff_meta(&s->buf, zminus, xminus, zplus,
 	    fsl_buffer_str(&xplus), s->diff_flags, change);
 	if (rc)
@@ -5153,6 +8163,7 @@ diff_non_checkin(fsl_buffer *buf, struct fnc_commit_artifact *commit,
 	fsl_buffer	 pwiki = fsl_buffer_empty;
 	fsl_id_t	 prid = 0;
 	fsl_size_t	 idx;
+	char		 hex[FNC_HASH_HEXSZ];
 	int		 rc = 0;
 
 	fsl_deck *d = NULL;
@@ -5200,8 +8211,13 @@ diff_non_checkin(fsl_buffer *buf, struct fnc_commit_artifact *commit,
 				fsl_buffer_appendf(buf, "\ncheckin %s",
 				    ctl->uuid);
 			fsl_buffer_appendf(buf, "\n%s", ctl->name);
-			if (!fsl_strcmp(ctl->name, "branch"))
+			if (!fsl_strcmp(ctl->name, "branch")) {
+				if (commit->arena == NULL || FLAG_CHK(
+				    commit->heapstr, COMMIT_HEAP_BRANCH))
+					fsl_free(commit->branch);
 				commit->branch = fsl_strdup(ctl->value);
+				FLAG_SET(commit->heapstr, COMMIT_HEAP_BRANCH);
+			}
 			if (ctl->value)
 				fsl_buffer_appendf(buf, " -> %s", ctl->value);
 			fsl_buffer_append(buf, "\n\n", 2);
@@ -5214,17 +8230,22 @@ diff_non_checkin(fsl_buffer *buf, struct fnc_commit_artifact *commit,
 	 * entire wiki card content.
 	 */
 	fsl_buffer_append(&wiki, d->W.mem, d->W.used);
-	if (commit->puuid == NULL) {
-		if (d->P.used > 0)
-			commit->puuid = fsl_strdup(d->P.list[0]);
-		else {
+	if (commit->puuid.len == 0) {
+		if (d->P.used > 0) {
+			rc = fnc_hash_decode(&commit->puuid, d->P.list[0]);
+			if (rc) {
+				rc = RC(rc, "invalid hash: %s", d->P.list[0]);
+				goto end;
+			}
+		} else {
 			fsl_buffer_copy(buf, &wiki);
 			goto end;
 		}
 	}
 
 	/* Diff the artifacts if a parent is found. */
-	rc = fsl_sym_to_rid(f, commit->puuid, FSL_SATYPE_ANY, &prid);
+	rc = fsl_sym_to_rid(f, fnc_hash_hex(&commit->puuid, hex),
+	    FSL_SATYPE_ANY, &prid);
 	if (rc)
 		goto end;
 	rc = fsl_deck_load_rid(f, d, prid, FSL_SATYPE_ANY);
@@ -5248,125 +8269,157 @@ end:
 
 /*
  * Compute the differences between two repository file artifacts to produce the
- * set of changes necessary to convert one into the other.
- *   buf         output buffer in which diff output will be appended
- *   vid1        repo record id of the version from which artifact a belongs
- *   a           file artifact being diffed against
- *   vid2        repo record id of the version from which artifact b belongs
- *   b           file artifact being diffed
- *   change      enum denoting the versioning change of the file
- *   diff_flags  bitwise flags to control the diff
- *   context     the number of context lines to surround changes
- *   sbs	 number of columns in which to display each side-by-side diff
+ * set of changes necessary to convert one into the other. If they can't be
+ * diffed because they're binary or too different, say so instead. The
+ * artifacts are only read, and only diffed, the first time the task is done
+ * with the same FNC_DIFF_LINE_FLAGS; thereafter the diff is only rendered.
+ *   cx          diff thread context, which has the version cx->rid from
+ *               which artifact t->b belongs, the version cx->id1 from which
+ *               t->a belongs, and the diff_flags, context, and sbs of the diff
+ *   f           the calling thread's clone of fcli_cx() to read them from
+ *   t           the task, whose buf the diff is appended to
  */
 static int
-diff_file_artifact(struct fnc_diff_view_state *s, fsl_id_t vid1,
-    const fsl_card_F *a, const fsl_card_F *b, enum fsl_ckout_change_e change)
+diff_file_artifact(struct fnc_diff_thread_cx *cx, fsl_cx *f,
+    struct fnc_diff_task *t)
 {
-	fsl_cx		*const f = fcli_cx();
-	fsl_stmt	 stmt = fsl_stmt_empty;
-	fsl_buffer	 fbuf1 = fsl_buffer_empty;
-	fsl_buffer	 fbuf2 = fsl_buffer_empty;
-	char		*zminus0 = NULL, *zplus0 = NULL;
-	const char	*zplus = NULL, *zminus = NULL;
-	fsl_uuid_str	 xplus0 = NULL, xminus0 = NULL;
-	fsl_uuid_str	 xplus = NULL, xminus = NULL;
-	fsl_id_t	 vid2 = s->selected_commit->rid;
-	int		 rc = 0;
+	const fsl_card_F	*a = t->a, *b = t->b;
+	fsl_buffer		*buf = &t->buf;
+	int			 rc = 0;
 
-	assert(vid1 != vid2);
-	assert(vid2 > 0 &&
+	assert(cx->id1 != cx->rid);
+	assert(cx->rid > 0 &&
 	    "local checkout should be diffed with diff_checkout()");
 
-	fbuf2.used = fbuf1.used = 0;
+	if (!t->fetched && (rc = fetch_diff_task(cx, f, t)))
+		return rc;
+
+	rc = write_diff_meta(buf, a ? a->name : t->zminus,
+	    a ? a->uuid : t->xminus, b ? b->name : t->zplus,
+	    b ? b->uuid : t->xplus, cx->diff_flags, t->change);
+	if (rc)
+		return rc;
+
+	if (FLAG_CHK(cx->diff_flags, FNC_DIFF_VERBOSE) || (a && b)) {
+		rc = fnc_diff_prepare(&t->diff, &t->blob1, &t->blob2,
+		    cx->diff_flags);
+		if (!rc)
+			rc = fnc_diff_render(&t->diff, &t->blob1, &t->blob2,
+			    diff_output_f_buffer, buf, cx->context, cx->sbs,
+			    cx->diff_flags);
+	}
+	if (rc == FSL_RC_RANGE || rc == FSL_RC_DIFF_BINARY)
+		rc = fsl_buffer_append(buf, rc == FSL_RC_RANGE ?
+		    "\nDiff has too many changes\n" :
+		    "\nBinary files cannot be diffed\n", -1);
+	else if (rc)
+		fsl_cx_err_set(f, rc, "%s: fnc_diff_render\n"
+		    " -> %s [%s]\n -> %s [%s]", fsl_rc_cstr(rc),
+		    a ? a->name : NULL_DEVICE, a ? a->uuid : NULL_DEVICE,
+		    b ? b->name : NULL_DEVICE, b ? b->uuid : NULL_DEVICE);
+
+	return rc;
+}
+
+/*
+ * Append n bytes of diff from src to the fsl_buffer state, doubling it when
+ * full. fsl_output_f_buffer() only grows the buffer by what's appended, which
+ * reallocs once per line, and copies the diff each time it can't grow in place
+ * among the blobs kept by the tasks.
+ */
+static int
+diff_output_f_buffer(void *state, const void *src, fsl_size_t n)
+{
+	fsl_buffer	*buf = state;
+	int		 rc;
+
+	if (buf->used + n + 1 > buf->capacity) {
+		rc = fsl_buffer_reserve(buf,
+		    MAX(buf->capacity * 2, buf->used + n + 1));
+		if (rc)
+			return rc;
+	}
+
+	return fsl_buffer_append(buf, src, n);
+}
+
+/*
+ * Read the content of the file artifacts of t into t->blob1 and t->blob2 with
+ * f. A blob diff has no F-cards, so look up the name and hash of the blobs
+ * cx->id1 and cx->rid instead.
+ */
+static int
+fetch_diff_task(struct fnc_diff_thread_cx *cx, fsl_cx *f,
+    struct fnc_diff_task *t)
+{
+	fsl_stmt	 stmt = fsl_stmt_empty;
+	fsl_id_t	 vid1 = cx->id1, vid2 = cx->rid;
+	int		 rc = 0;
+
+	fsl_buffer_reuse(&t->blob1);
+	fsl_buffer_reuse(&t->blob2);
 
-	if (a) {
-		rc = fsl_card_F_content(f, a, &fbuf1);
+	if (t->a) {
+		rc = fsl_card_F_content(f, t->a, &t->blob1);
 		if (rc)
 			goto end;
-		zminus = a->name;
-		xminus = a->uuid;
-	} else if (s->selected_commit->diff_type == FNC_DIFF_BLOB) {
+	} else if (cx->type == FNC_DIFF_BLOB) {
 		rc = fsl_cx_prepare(f, &stmt,
 		    "SELECT name FROM filename, mlink "
 		    "WHERE filename.fnid=mlink.fnid AND mlink.fid = %d", vid1);
 		if (rc) {
-			rc = RC(FSL_RC_DB, "%s %d", "fsl_cx_prepare", vid1);
+			rc = fsl_cx_err_set(f, FSL_RC_DB, "%s %d",
+			    "fsl_cx_prepare", vid1);
 			goto end;
 		}
 		rc = fsl_stmt_step(&stmt);
 		if (rc == FSL_RC_STEP_ROW) {
 			rc = 0;
-			zminus0 = fsl_strdup(fsl_stmt_g_text(&stmt, 0, NULL));
-			zminus = zminus0;
+			fsl_free(t->zminus);
+			t->zminus = fsl_strdup(fsl_stmt_g_text(&stmt, 0, NULL));
 		} else if (rc == FSL_RC_STEP_DONE)
 			rc = 0;
 		else if (rc) {
-			rc = RC(rc, "%s", "fsl_stmt_step");
+			rc = fsl_cx_err_set(f, rc, "%s", "fsl_stmt_step");
 			goto end;
 		}
-		xminus0 = fsl_rid_to_uuid(f, vid1);
-		xminus = xminus0;
+		fsl_free(t->xminus);
+		t->xminus = fsl_rid_to_uuid(f, vid1);
 		fsl_stmt_finalize(&stmt);
-		fsl_content_get(f, vid1, &fbuf1);
+		fsl_content_get(f, vid1, &t->blob1);
 	}
-	if (b) {
-		rc = fsl_card_F_content(f, b, &fbuf2);
+	if (t->b) {
+		rc = fsl_card_F_content(f, t->b, &t->blob2);
 		if (rc)
 			goto end;
-		zplus = b->name;
-		xplus = b->uuid;
-	} else if (s->selected_commit->diff_type == FNC_DIFF_BLOB) {
+	} else if (cx->type == FNC_DIFF_BLOB) {
 		rc = fsl_cx_prepare(f, &stmt,
 		    "SELECT name FROM filename, mlink "
 		    "WHERE filename.fnid=mlink.fnid AND mlink.fid = %d", vid2);
 		if (rc) {
-			rc = RC(FSL_RC_DB, "%s %d", "fsl_cx_prepare", vid2);
+			rc = fsl_cx_err_set(f, FSL_RC_DB, "%s %d",
+			    "fsl_cx_prepare", vid2);
 			goto end;
 		}
 		rc = fsl_stmt_step(&stmt);
 		if (rc == FSL_RC_STEP_ROW) {
 			rc = 0;
-			zplus0 = fsl_strdup(fsl_stmt_g_text(&stmt, 0, NULL));
-			zplus = zplus0;
+			fsl_free(t->zplus);
+			t->zplus = fsl_strdup(fsl_stmt_g_text(&stmt, 0, NULL));
 		} else if (rc == FSL_RC_STEP_DONE)
 			rc = 0;
 		else if (rc) {
-			rc = RC(rc, "%s", "fsl_stmt_step");
+			rc = fsl_cx_err_set(f, rc, "%s", "fsl_stmt_step");
 			goto end;
 		}
-		xplus0 = fsl_rid_to_uuid(f, vid2);
-		xplus = xplus0;
+		fsl_free(t->xplus);
+		t->xplus = fsl_rid_to_uuid(f, vid2);
 		fsl_stmt_finalize(&stmt);
-		fsl_content_get(f, vid2, &fbuf2);
+		fsl_content_get(f, vid2, &t->blob2);
 	}
-
-	if (s->buf.used) {
-		s->index.offset = fsl_realloc(s->index.offset,
-		    (s->index.n + 1) * sizeof(off_t));
-		s->index.offset[s->index.n++] = s->buf.used +
-		    s->index.offset[0];
-	}
-	rc = write_diff_meta(&s->buf, zminus, xminus, zplus, xplus,
-	    s->diff_flags, change);
-	if (rc)
-		goto end;
-
-	if (FLAG_CHK(s->diff_flags, FNC_DIFF_VERBOSE) || (a && b))
-		rc = fnc_diff_text_to_buffer(&fbuf1, &fbuf2, &s->buf,
-		    s->context, s->sbs, s->diff_flags);
-	if (rc)
-		RC(rc, "%s: fnc_diff_text_to_buffer\n"
-		    " -> %s [%s]\n -> %s [%s]", fsl_rc_cstr(rc),
-		    a ? a->name : NULL_DEVICE, a ? a->uuid : NULL_DEVICE,
-		    b ? b->name : NULL_DEVICE, b ? b->uuid : NULL_DEVICE);
+	t->fetched = true;
 end:
-	fsl_free(zminus0);
-	fsl_free(zplus0);
-	fsl_free(xminus0);
-	fsl_free(xplus0);
-	fsl_buffer_clear(&fbuf1);
-	fsl_buffer_clear(&fbuf2);
+	fsl_stmt_finalize(&stmt);
 	return rc;
 }
 
@@ -5375,6 +8428,11 @@ show_diff(struct fnc_view *view)
 {
 	struct fnc_diff_view_state	*s = &view->state.diff;
 	char				*headln, *id2, *id1 = NULL;
+	int				 rc;
+
+	if (s->thread_id && s->thread_cx.complete &&
+	    (rc = stop_diff(s, false)))
+		return rc;
 
 	/* Some diffs (e.g., technote, tag) have no parent hash to display. */
 	id1 = fsl_strdup(s->id1 ? s->id1 : "/dev/null");
@@ -5391,7 +8449,8 @@ show_diff(struct fnc_view *view)
 		return RC(FSL_RC_ERROR, "%s", "fsl_strdup");
 	}
 
-	if ((headln = fsl_mprintf("diff %.40s %.40s", id1, id2)) == NULL) {
+	if ((headln = fsl_mprintf("%sdiff %.40s %.40s",
+	    s->thread_id ? "generating... " : "", id1, id2)) == NULL) {
 		fsl_free(id1);
 		fsl_free(id2);
 		return RC(FSL_RC_RANGE, "%s", "fsl_mprintf");
@@ -5410,9 +8469,6 @@ write_diff(struct fnc_view *view, char *headln)
 	struct fnc_colour		*c = NULL;
 	wchar_t				*wcstr;
 	char				*line;
-	size_t				 linesz = 0;
-	ssize_t				 linelen;
-	off_t				 line_offset;
 	attr_t				 rx = A_BOLD;
 	int				 col, wstrlen, max_lines = view->nlines;
 	int				 nlines = s->nlines;
@@ -5420,9 +8476,6 @@ write_diff(struct fnc_view *view, char *headln)
 	bool				 selected;
 
 	s->lineno = s->first_line_onscreen - 1;
-	line_offset = s->line_offsets[s->first_line_onscreen - 1];
-	if (fseeko(s->f, line_offset, SEEK_SET))
-		return RC(fsl_errno_to_rc(errno, FSL_RC_ERROR), "%s", "fseeko");
 
 	werase(view->window);
 
@@ -5463,22 +8516,13 @@ write_diff(struct fnc_view *view, char *headln)
 	}
 
 	s->eof = false;
-	line = NULL;
 	while (max_lines > 0 && nprinted < max_lines) {
-		linelen = getline(&line, &linesz, s->f);
-		if (linelen == -1) {
-			if (feof(s->f)) {
-				s->eof = true;
-				break;
-			}
-			fsl_free(line);
-			RC(ferror(s->f) ? fsl_errno_to_rc(errno, FSL_RC_IO) :
-			    FSL_RC_IO, "%s", "getline");
-			return rc;
+		if ((size_t)s->lineno >= s->nlines) {
+			s->eof = true;
+			break;
 		}
+		line = (char *)s->text.mem + s->line_offsets[s->lineno++];
 
-		if (++s->lineno < s->first_line_onscreen)
-			continue;
 		if (s->gtl)
 			if (!gotoline(view, &s->lineno, &nprinted))
 				continue;
@@ -5500,17 +8544,13 @@ write_diff(struct fnc_view *view, char *headln)
 		    regmatch->rm_so >= 0 && regmatch->rm_so < regmatch->rm_eo) {
 			rc = draw_matched_line(view, &wstrlen, npad, regmatch,
 			    rx);
-			if (rc) {
-				fsl_free(line);
+			if (rc)
 				return rc;
-			}
 		} else {
 			rc = formatln(&wcstr, &wstrlen, line,
 			    view->ncols - npad, npad, view->pos.col, true);
-			if (rc) {
-				fsl_free(line);
+			if (rc)
 				return rc;
-			}
 			waddwstr(view->window, wcstr);
 			fsl_free(wcstr);
 			wcstr = NULL;
@@ -5524,7 +8564,6 @@ write_diff(struct fnc_view *view, char *headln)
 		if (++nprinted == 1)
 			s->first_line_onscreen = s->lineno;
 	}
-	fsl_free(line);
 	if (nprinted >= 1)
 		s->last_line_onscreen = s->first_line_onscreen + (nprinted - 1);
 	else
@@ -5532,7 +8571,8 @@ write_diff(struct fnc_view *view, char *headln)
 
 	drawborder(view);
 
-	if (s->eof) {
+	/* While it's being made, the end of the diff is only so far. */
+	if (s->eof && !s->thread_id) {
 		while (nprinted++ < view->nlines)
 			waddch(view->window, '\n');
 
@@ -5707,10 +8747,7 @@ diff_input_handler(struct fnc_view **new_view, struct fnc_view *view, int ch)
 	struct fnc_diff_view_state	*s = &view->state.diff;
 	struct fnc_tl_view_state	*tlstate;
 	struct commit_entry		*previous_selection;
-	char				*line = NULL;
-	ssize_t				 linelen;
-	size_t				 linesz = 0;
-	int				 nlines, i = 0, rc = FSL_RC_OK;
+	int				 nlines, rc = FSL_RC_OK;
 	uint16_t			 nscroll = view->nlines - 2;
 	bool				 tl_down = false;
 
@@ -5734,7 +8771,8 @@ diff_input_handler(struct fnc_view **new_view, struct fnc_view *view, int ch)
 		view->pos.col -= MIN(view->pos.col, 2);
 		break;
 	case CTRL('p'):
-		if (s->selected_commit->diff_type == FNC_DIFF_WIKI)
+		if (s->selected_commit->diff_type == FNC_DIFF_WIKI ||
+		    s->index.n == 0)
 			break;
 		if (!((size_t)s->lineno > s->index.lineno[s->index.n - 1])) {
 			if (s->index.idx == 0)
@@ -5747,7 +8785,8 @@ diff_input_handler(struct fnc_view **new_view, struct fnc_view *view, int ch)
 		s->selected_line = 1;
 		break;
 	case CTRL('n'):
-		if (s->selected_commit->diff_type == FNC_DIFF_WIKI)
+		if (s->selected_commit->diff_type == FNC_DIFF_WIKI ||
+		    s->index.n == 0)
 			break;
 		if (!((size_t)s->lineno < s->index.lineno[0])) {
 			if (++s->index.idx == s->index.n)
@@ -5798,23 +8837,19 @@ diff_input_handler(struct fnc_view **new_view, struct fnc_view *view, int ch)
 			s->selected_line += MIN(nscroll, move);
 			break;
 		}
-		while (!s->eof && i++ < nscroll) {
-			linelen = getline(&line, &linesz, s->f);
-			++s->first_line_onscreen;
-			if (linelen == -1) {
-				if (!feof(s->f))
-					return RC(ferror(s->f) ?
-					    fsl_errno_to_rc(errno, FSL_RC_IO) :
-					    FSL_RC_IO, "%s", "getline");
-				if (s->selected_line > nscroll)
-					s->selected_line = view->nlines - 2;
-				else
-					s->selected_line = nscroll;
-				s->eof = true;
-				break;
-			}
+		if (s->eof)
+			break;
+		/* Scroll to the last line if it's less than a page away. */
+		if (nlines - s->last_line_onscreen >= nscroll) {
+			s->first_line_onscreen += nscroll;
+			break;
 		}
-		fsl_free(line);
+		s->first_line_onscreen += nlines - s->last_line_onscreen + 1;
+		if (s->selected_line > nscroll)
+			s->selected_line = view->nlines - 2;
+		else
+			s->selected_line = nscroll;
+		s->eof = true;
 		break;
 	case CTRL('u'):
 		nscroll >>= 1;
@@ -5826,8 +8861,8 @@ diff_input_handler(struct fnc_view **new_view, struct fnc_view *view, int ch)
 			s->selected_line -= MIN(nscroll, move);
 			break;
 		}
-		while (i++ < nscroll && s->first_line_onscreen > 1)
-			--s->first_line_onscreen;
+		s->first_line_onscreen = MAX(s->first_line_onscreen - nscroll,
+		    1);
 		break;
 	case KEY_END:
 	case 'G':
@@ -5859,7 +8894,8 @@ diff_input_handler(struct fnc_view **new_view, struct fnc_view *view, int ch)
 		s->index.idx = 0;
 		break;
 	case 'F':
-		if (s->selected_commit->diff_type == FNC_DIFF_WIKI)
+		if (s->selected_commit->diff_type == FNC_DIFF_WIKI ||
+		    s->index.n == 0)
 			break;
 		fsl_buffer	 buf = fsl_buffer_empty;
 		struct input	 input;
@@ -5984,6 +9020,7 @@ diff_input_handler(struct fnc_view **new_view, struct fnc_view *view, int ch)
 
 		if ((rc = set_selected_commit(s, tlstate->selected_commit)))
 			break;
+		tlstate->diff_idx = tlstate->selected_commit->idx;
 
 		s->selected_line = 1;
 		reset_diff_view(view, false);
@@ -6002,6 +9039,8 @@ reset_diff_view(struct fnc_view *view, bool stay)
 	int				 n, rc = FSL_RC_OK;
 
 	n = s->nlines;
+	if ((rc = stop_diff(s, true)))
+		return rc;
 	free_index(&s->index);
 	show_diff_status(view);
 	rc = create_diff(s);
@@ -6010,6 +9049,10 @@ reset_diff_view(struct fnc_view *view, bool stay)
 
 	if (stay) {
 		float scale = (float)s->first_line_onscreen / n;
+
+		/* Wait for the whole diff to keep our place in it. */
+		if ((rc = stop_diff(s, false)))
+			return rc;
 		s->first_line_onscreen = MAX(1, (int)(s->nlines * scale));
 	} else {
 		s->first_line_onscreen = 1;
@@ -6038,12 +9081,14 @@ request_tl_commits(struct fnc_view *view)
 static int
 set_selected_commit(struct fnc_diff_view_state *s, struct commit_entry *entry)
 {
+	char	hex[FNC_HASH_HEXSZ];
+
 	fsl_free(s->id2);
-	s->id2 = fsl_strdup(entry->commit->uuid);
+	s->id2 = fsl_strdup(fnc_hash_hex(&entry->commit->uuid, hex));
 	if (s->id2 == NULL)
 		return RC(FSL_RC_ERROR, "%s", "fsl_strdup");
 	fsl_free(s->id1);
-	s->id1 = entry->commit->puuid ? fsl_strdup(entry->commit->puuid) : NULL;
+	s->id1 = fsl_strdup(fnc_hash_hex(&entry->commit->puuid, hex));
 	s->selected_commit = entry->commit;
 
 	return 0;
@@ -6060,16 +9105,17 @@ diff_grep_init(struct fnc_view *view)
 static int
 find_next_match(struct fnc_view *view)
 {
-	FILE	*f = NULL;
-	off_t	*line_offsets = NULL;
-	ssize_t	 linelen;
-	size_t	 nlines = 0, linesz = 0;
-	int	*first, *last, *match, *selected;
-	int	 lineno;
-	char	*line = NULL;
+	FILE		*f = NULL;
+	const char	*text = NULL, *ln;
+	off_t		*line_offsets = NULL;
+	ssize_t		 linelen;
+	size_t		 nlines = 0, linesz = 0;
+	int		*first, *last, *match, *selected;
+	int		 lineno;
+	char		*line = NULL;
 
 	first = last = match = selected = NULL;
-	grep_set_view(view, &f, &line_offsets, &nlines, &first, &last,
+	grep_set_view(view, &f, &text, &line_offsets, &nlines, &first, &last,
 	    &match, &selected);
 
 	if (view->searching == SEARCH_DONE) {
@@ -6105,18 +9151,24 @@ find_next_match(struct fnc_view *view)
 		}
 
 		offset = line_offsets[lineno - 1];
-		if (fseeko(f, offset, SEEK_SET) != 0) {
-			fsl_free(line);
-			return RC(fsl_errno_to_rc(errno, FSL_RC_IO),
-			    "%s", "fseeko");
+		if (text != NULL) {
+			ln = text + offset;
+			linelen = line_offsets[lineno] - offset - 1;
+		} else {
+			if (fseeko(f, offset, SEEK_SET) != 0) {
+				fsl_free(line);
+				return RC(fsl_errno_to_rc(errno, FSL_RC_IO),
+				    "%s", "fseeko");
+			}
+			linelen = getline(&line, &linesz, f);
+			ln = line;
 		}
 		/*
 		 * Expand tabs for accurate rm_so/rm_eo offsets, and save to
 		 * view->line so we don't have to expand when drawing matches.
 		 */
-		linelen = getline(&line, &linesz, f);
 		view->line.sz = expand_tab(view->line.buf,
-		    sizeof(view->line.buf), line, linelen);
+		    sizeof(view->line.buf), ln, linelen);
 		if (linelen != -1 && regexec(&view->regex, view->line.buf, 1,
 		    &view->regmatch, 0) == 0) {
 			view->search_status = SEARCH_CONTINUE;
@@ -6148,13 +9200,18 @@ find_next_match(struct fnc_view *view)
 	return FSL_RC_OK;
 }
 
+/*
+ * Point the search at the lines of the view: the diff view keeps them in
+ * memory (*text), and the blame view in a file (*f).
+ */
 static void
-grep_set_view(struct fnc_view *view, FILE **f, off_t **line_offsets,
-    size_t *nlines, int **first, int **last, int **match, int **selected)
+grep_set_view(struct fnc_view *view, FILE **f, const char **text,
+    off_t **line_offsets, size_t *nlines, int **first, int **last,
+    int **match, int **selected)
 {
 	if (view->vid == FNC_VIEW_DIFF) {
 		struct fnc_diff_view_state *s = &view->state.diff;
-		*f = s->f;
+		*text = (const char *)s->text.mem;
 		*nlines = s->nlines;
 		*line_offsets = s->line_offsets;
 		*match = &s->matched_line;
@@ -6179,8 +9236,18 @@ close_diff_view(struct fnc_view *view)
 	struct fnc_diff_view_state	*s = &view->state.diff;
 	int				 rc = 0;
 
-	if (s->f && fclose(s->f) == EOF)
-		rc = RC(fsl_errno_to_rc(errno, FSL_RC_IO), "%s", "fclose");
+	rc = stop_diff(s, true);
+	/* Let the timeline trim our commit's chunk, if it's still open. */
+	if (view->parent && view->parent == s->timeline_view)
+		s->timeline_view->state.timeline.diff_idx = -1;
+	free_diff_tasks(&s->thread_cx);
+	fsl_cx_finalize(s->thread_cx.f);
+	s->thread_cx.f = NULL;
+	while (s->thread_cx.npool > 0)
+		fsl_cx_finalize(s->thread_cx.pool[--s->thread_cx.npool].f);
+	while (!TAILQ_EMPTY(&s->cache))
+		diff_cache_evict(s, TAILQ_FIRST(&s->cache));
+	fsl_buffer_clear(&s->text);
 	fsl_free(s->id1);
 	s->id1 = NULL;
 	fsl_free(s->id2);
@@ -6188,6 +9255,7 @@ close_diff_view(struct fnc_view *view)
 	fsl_free(s->line_offsets);
 	free_colours(&s->colours);
 	s->line_offsets = NULL;
+	s->noffsets = 0;
 	s->nlines = 0;
 	free_index(&s->index);
 	return rc;
@@ -6200,8 +9268,6 @@ free_index(struct index *index)
 	index->n = 0;
 	fsl_free(index->lineno);
 	index->lineno = NULL;
-	fsl_free(index->offset);
-	index->offset = NULL;
 }
 
 static void
@@ -6365,8 +9431,8 @@ usage_timeline(void)
 {
 	fsl_fprintf(fnc_init.err ? stderr : stdout,
 	    " usage: %s timeline [-C|--no-colour] [-R path] [-T tag] "
-	    "[-b branch] [-c commit] [-f glob] [-h|--help] [-n n] [-t type] "
-	    "[-u user] [-z|--utc] [path]\n"
+	    "[-a|--ancestors] [-b branch] [-c commit] [-f glob] [-h|--help] "
+	    "[-n n] [-t type] [-u user] [-z|--utc] [path]\n"
 	    "  e.g.: %s timeline --type ci -u jimmy src/frobnitz.c\n\n",
 	    fcli_progname(), fcli_progname());
 }
@@ -6553,15 +9619,16 @@ cmd_diff(fcli_command const *argv)
 
 	if (diff_type != FNC_DIFF_BLOB && diff_type != FNC_DIFF_CKOUT) {
 		q = fsl_stmt_malloc();
-		rc = commit_builder(&commit, rid, q);
+		rc = commit_builder(&commit, rid, q, NULL);
 		if (rc)
 			goto end;
 		if (commit->prid == prid)
 			showmeta = true;
 		else {
-			fsl_free(commit->puuid);
 			commit->prid = prid;
-			commit->puuid = fsl_rid_to_uuid(f, prid);
+			rc = fnc_hash_from_rid(&commit->puuid, prid);
+			if (rc)
+				goto end;
 		}
 	} else {
 		commit = calloc(1, sizeof(*commit));
@@ -6572,9 +9639,12 @@ cmd_diff(fcli_command const *argv)
 		}
 		commit->prid = prid;
 		commit->rid = rid;
-		commit->puuid = fsl_rid_to_uuid(f, prid);
-		commit->uuid = fsl_rid_to_uuid(f, rid);
-		commit->type = fsl_strdup("blob");
+		rc = fnc_hash_from_rid(&commit->puuid, prid);
+		if (!rc)
+			rc = fnc_hash_from_rid(&commit->uuid, rid);
+		if (rc)
+			goto end;
+		commit->type = "blob";
 		commit->diff_type = diff_type;
 	}
 
@@ -8107,16 +11177,6 @@ view_set_child(struct fnc_view *view, struct fnc_view *child)
 {
 	view->child = child;
 	child->parent = view;
-
-	/*
-	 * If the timeline is open and has not yet loaded /all/ commits, cached
-	 * stmts require resetting the commit builder stmt before restepping.
-	 */
-	if (view->vid == FNC_VIEW_TIMELINE) {
-		struct fnc_tl_thread_cx *tcx = &view->state.timeline.thread_cx;
-		if (tcx && !tcx->eotl)
-			tcx->reset = true;
-	}
 }
 
 static int
@@ -8418,11 +11478,48 @@ fnc_home(struct fnc_view *view)
 	halfdelay(10);	/* Block for 1 second, then return ERR. */
 	if (wgetch(view->window) != 'g')
 		home = false;
-	cbreak();	/* Return to blocking mode on user input. */
+	reset_input_mode();
 
 	return home;
 }
 
+/*
+ * Count a view whose content is being made by a thread, unless *polling says
+ * it already is, and poll for input so that it's redrawn as it's made. The
+ * blame, diff, and timeline search threads may all run at once, so input is
+ * only blocked on again once the last of them is done.
+ */
+static void
+start_polling(bool *polling)
+{
+	if (!*polling) {
+		*polling = true;
+		++nproducers;
+	}
+	halfdelay(1);
+}
+
+/* Stop counting a view counted by start_polling(), if it is. */
+static void
+stop_polling(bool *polling)
+{
+	if (*polling) {
+		*polling = false;
+		--nproducers;
+	}
+	reset_input_mode();
+}
+
+/* Poll for input if any view's content is being made, else block on it. */
+static void
+reset_input_mode(void)
+{
+	if (nproducers)
+		halfdelay(1);
+	else
+		cbreak();
+}
+
 static int
 cmd_blame(fcli_command const *argv)
 {
@@ -8688,6 +11785,9 @@ run_blame(struct fnc_view *view)
 	}
 	blame->cb_cx.quit = &s->done;
 
+	rc = fnc_cx_clone(&blame->thread_cx.f);
+	if (rc)
+		goto end;
 	blame->thread_cx.path = s->path;
 	blame->thread_cx.cb_cx = &blame->cb_cx;
 	blame->thread_cx.complete = &s->blame_complete;
@@ -8824,11 +11924,11 @@ show_blame_view(struct fnc_view *view)
 			return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
 			    "%s", "pthread_create");
 
-		halfdelay(1);	/* Fast refresh while annotating.  */
+		start_polling(&s->polling);  /* Refresh while annotating. */
 	}
 
 	if (s->blame_complete)
-		cbreak();	/* Return to blocking mode. */
+		stop_polling(&s->polling);
 
 	rc = draw_blame(view);
 	drawborder(view);
@@ -8836,10 +11936,14 @@ show_blame_view(struct fnc_view *view)
 	return rc;
 }
 
+/*
+ * Annotate the file on the thread's own clone of fcli_cx() so that the main
+ * thread can continue to use fcli_cx() without fnc_mutex being held for the
+ * whole annotation, which is only taken to record each annotated line.
+ */
 static void *
 blame_thread(void *state)
 {
-	fsl_cx				*const f = fcli_cx();
 	struct fnc_blame_thread_cx	*cx = state;
 	int				 rc0, rc;
 
@@ -8847,11 +11951,9 @@ blame_thread(void *state)
 	if (rc)
 		return (void *)(intptr_t)rc;
 
-	rc = fsl_annotate(f, &cx->blame_opt);
-	if (rc && fsl_cx_err_get_e(f)->code == FSL_RC_BREAK) {
-		fcli_err_reset();
+	rc = fsl_annotate(cx->f, &cx->blame_opt);
+	if (rc == FSL_RC_BREAK)
 		rc = 0;
-	}
 
 	rc0 = pthread_mutex_lock(&fnc_mutex);
 	if (rc0)
@@ -8874,15 +11976,16 @@ blame_cb(void *state, fsl_annotate_opt const * const opt,
 {
 	struct fnc_blame_cb_cx	*cx = state;
 	struct fnc_blame_line	*line;
-	int			 rc = 0;
+	int			 rc = 0, err;
 
 	rc = pthread_mutex_lock(&fnc_mutex);
 	if (rc)
 		return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
 		    "%s", "pthread_mutex_lock");
 
+	/* Stop fsl_annotate(), which returns this to blame_thread(). */
 	if (*cx->quit) {
-		rc = fcli_err_set(FSL_RC_BREAK, "user quit");
+		rc = FSL_RC_BREAK;
 		goto end;
 	}
 
@@ -8910,9 +12013,9 @@ blame_cb(void *state, fsl_annotate_opt const * const opt,
 	cx->maxlen = MAX(step->lineLength, cx->maxlen);
 	++cx->nlines;
 end:
-	rc = pthread_mutex_unlock(&fnc_mutex);
-	if (rc)
-		rc = RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
+	err = pthread_mutex_unlock(&fnc_mutex);
+	if (err && !rc)
+		rc = RC(fsl_errno_to_rc(err, FSL_RC_ACCESS),
 		    "%s", "pthread_mutex_unlock");
 	return rc;
 }
@@ -9141,12 +12244,13 @@ gotoline(struct fnc_view *view, int *lineno, int *nprinted)
 		selected = &s->selected_line;
 		gtl = &s->gtl;
 		eof = &s->eof;
-		f = s->f;
 	} else
 		return false;
 
+	/* Diff lines are read from memory from *lineno on. */
 	if (*first != 1 && (*lineno >= *gtl - (view->nlines - 3) / 2)) {
-		rewind(f);
+		if (f != NULL)
+			rewind(f);
 		*nprinted = 0;
 		*eof = false;
 		*first = 1;
@@ -9397,7 +12501,7 @@ blame_input_handler(struct fnc_view **new_view, struct fnc_view *view, int ch)
 		if (rc)
 			break;
 		q = fsl_stmt_malloc();
-		rc = commit_builder(&commit, fsl_uuid_to_rid(f, id), q);
+		rc = commit_builder(&commit, fsl_uuid_to_rid(f, id), q, NULL);
 		fsl_stmt_finalize(q);
 		if (rc) {
 			fnc_commit_artifact_close(commit);
@@ -9494,6 +12598,7 @@ close_blame_view(struct fnc_view *view)
 	int				 rc = 0;
 
 	rc = stop_blame(&s->blame);
+	stop_polling(&s->polling);
 
 	while (!CONCAT(STAILQ, _EMPTY)(&s->blamed_commits)) {
 		struct fnc_commit_qid *blamed_commit;
@@ -9527,12 +12632,10 @@ stop_blame(struct fnc_blame *blame)
 		if (rc)
 			return RC(fsl_errno_to_rc(rc, FSL_RC_ACCESS),
 			    "%s", "pthread_mutex_lock");
-		if (!rc && fsl_cx_err_get_e(fcli_cx())->code == FSL_RC_BREAK) {
-			rc = 0;
-			fcli_err_reset();
-		}
 		blame->thread_id = 0;
 	}
+	fsl_cx_finalize(blame->thread_cx.f);
+	blame->thread_cx.f = NULL;
 	if (blame->f) {
 		if (fclose(blame->f) == EOF && rc == 0)
 			rc = RC(fsl_errno_to_rc(errno, FSL_RC_IO), "%s",
@@ -10685,7 +13788,7 @@ init_unveil(const char *repodb, const char *ckoutdir, bool cfg)
 		return RC(fsl_errno_to_rc(errno, FSL_RC_ACCESS),
 		    "unveil(%s, \"rw\")", ckoutdir);
 
-	/* rwc /tmp for tmpfile() in help(), create_diff(), and run_blame(). */
+	/* rwc /tmp for tmpfile() in help() and run_blame(). */
 	if (unveil(P_tmpdir, "rwc") == -1)
 		return RC(fsl_errno_to_rc(errno, FSL_RC_ACCESS),
 		    "unveil(%s, \"rwc\")", P_tmpdir);